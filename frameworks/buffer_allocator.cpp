@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "buffer_allocator.h"
+
+#include <cstdlib>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "buffer_common.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+namespace OHOS {
+const uint32_t LOCAL_STRIDE_ALIGNMENT = 16;
+const uint32_t LOCAL_ADDR_ALIGNMENT = 64;
+const uint64_t HUGE_PAGE_SIZE = 2 * 1024 * 1024; // 2MB
+
+BufferAllocator* BufferAllocator::GetBuiltin(BufferAllocatorType type)
+{
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    static BufferAllocator* allocators[BUFFER_ALLOCATOR_MAX] = {nullptr};
+    RETURN_VAL_IF_FAIL((type >= BUFFER_ALLOCATOR_GRALLOC && type < BUFFER_ALLOCATOR_MAX), nullptr);
+    pthread_mutex_lock(&lock);
+    /* Never destroyed, buffers may still be freed when static objects are destroyed at exit. */
+    if (allocators[type] == nullptr) {
+        switch (type) {
+            case BUFFER_ALLOCATOR_GRALLOC: {
+                GrallocFuncs* grallocFuncs = nullptr;
+                if (GrallocInitialize(&grallocFuncs) == DISPLAY_SUCCESS && grallocFuncs != nullptr) {
+                    allocators[type] = new GrallocAllocator(grallocFuncs);
+                }
+                break;
+            }
+            case BUFFER_ALLOCATOR_MEMFD:
+                allocators[type] = new MemfdAllocator();
+                break;
+            case BUFFER_ALLOCATOR_ANONYMOUS:
+                allocators[type] = new AnonymousAllocator();
+                break;
+            case BUFFER_ALLOCATOR_HUGE_PAGE:
+                allocators[type] = new HugePageAllocator();
+                break;
+            default:
+                break;
+        }
+    }
+    BufferAllocator* allocator = allocators[type];
+    pthread_mutex_unlock(&lock);
+    return allocator;
+}
+
+uint32_t BufferAllocator::GetFootprint(const BufferHandle* handle)
+{
+    return static_cast<uint32_t>(handle->size);
+}
+
+int32_t GrallocAllocator::AllocMem(const AllocInfo& info, BufferHandle** handle)
+{
+    if (grallocFuncs_->AllocMem == nullptr) {
+        return DISPLAY_FAILURE;
+    }
+    return grallocFuncs_->AllocMem(&info, handle);
+}
+
+void GrallocAllocator::FreeMem(BufferHandle* handle)
+{
+    if (grallocFuncs_->FreeMem != nullptr) {
+        grallocFuncs_->FreeMem(handle);
+    }
+}
+
+void* GrallocAllocator::Mmap(BufferHandle* handle)
+{
+    if (grallocFuncs_->Mmap == nullptr) {
+        return nullptr;
+    }
+    return grallocFuncs_->Mmap(handle);
+}
+
+void* GrallocAllocator::MmapCache(BufferHandle* handle)
+{
+    if (grallocFuncs_->MmapCache == nullptr) {
+        return nullptr;
+    }
+    return grallocFuncs_->MmapCache(handle);
+}
+
+int32_t GrallocAllocator::Unmap(BufferHandle* handle)
+{
+    if (grallocFuncs_->Unmap == nullptr) {
+        return DISPLAY_FAILURE;
+    }
+    return grallocFuncs_->Unmap(handle);
+}
+
+int32_t GrallocAllocator::FlushCache(BufferHandle* handle)
+{
+    if (grallocFuncs_->FlushCache == nullptr) {
+        return DISPLAY_FAILURE;
+    }
+    return grallocFuncs_->FlushCache(handle);
+}
+
+int32_t GrallocAllocator::FlushMCache(BufferHandle* handle)
+{
+    if (grallocFuncs_->FlushMCache == nullptr) {
+        return DISPLAY_FAILURE;
+    }
+    return grallocFuncs_->FlushMCache(handle);
+}
+
+int32_t GrallocAllocator::InvalidateCache(BufferHandle* handle)
+{
+    if (grallocFuncs_->InvalidateCache == nullptr) {
+        return DISPLAY_FAILURE;
+    }
+    return grallocFuncs_->InvalidateCache(handle);
+}
+
+static uint32_t GetBytesPerPixel(PixelFormat format)
+{
+    switch (format) {
+        case PIXEL_FMT_RGB_565:
+        case PIXEL_FMT_RGBA_5551:
+            return 2; // 2 bytes per pixel
+        case PIXEL_FMT_RGB_888:
+            return 3; // 3 bytes per pixel
+        case PIXEL_FMT_RGBA_8888:
+            return 4; // 4 bytes per pixel
+        default:
+            return 1; // luma plane of yuv formats
+    }
+}
+
+/* Size of the buffer laid out in rows of the stride, which is aligned to the power of 2 alignment. */
+static uint64_t GetLayoutSize(const AllocInfo& info, uint64_t alignment, uint64_t& stride)
+{
+    stride = 0;
+    if ((info.usage & HBM_USE_ASSIGN_SIZE) != 0) {
+        return info.expectedSize;
+    }
+    stride = static_cast<uint64_t>(info.width) * GetBytesPerPixel(info.format);
+    stride = (stride + alignment - 1) & ~(alignment - 1);
+    uint64_t total = stride * info.height;
+    uint64_t chromaHeight = (static_cast<uint64_t>(info.height) + 1) / 2; // odd rows round up, as planes do
+    if (info.format == PIXEL_FMT_YCBCR_420_SP || info.format == PIXEL_FMT_YCRCB_420_SP) {
+        total += stride * chromaHeight; // interleaved chroma plane of full stride
+    } else if (info.format == PIXEL_FMT_YCBCR_420_P || info.format == PIXEL_FMT_YCRCB_420_P) {
+        total += 2 * ((stride + 1) / 2) * chromaHeight; // 2 chroma planes of half stride
+    }
+    return total;
+}
+
+uint32_t BufferAllocator::EstimateFootprint(const AllocInfo& info)
+{
+    /* The padding of the backend is unknown, the rows without padding are the least it holds. */
+    uint64_t stride = 0;
+    uint64_t total = GetLayoutSize(info, 1, stride);
+    return (total > INT32_MAX) ? 0 : static_cast<uint32_t>(total);
+}
+
+uint32_t LocalAllocator::EstimateFootprint(const AllocInfo& info)
+{
+    uint64_t stride = 0;
+    uint64_t total = GetLayoutSize(info, LOCAL_STRIDE_ALIGNMENT, stride);
+    return (total > INT32_MAX || stride > INT32_MAX) ? 0 : static_cast<uint32_t>(total);
+}
+
+BufferHandle* LocalAllocator::CreateHandle(const AllocInfo& info, uint32_t& size)
+{
+    uint64_t stride = 0;
+    uint64_t total = GetLayoutSize(info, LOCAL_STRIDE_ALIGNMENT, stride);
+    if (total == 0 || total > INT32_MAX || stride > INT32_MAX) {
+        GRAPHIC_LOGE("Invalid alloc info, size=%llu.", static_cast<unsigned long long>(total));
+        return nullptr;
+    }
+    BufferHandle* handle = static_cast<BufferHandle *>(calloc(1, sizeof(BufferHandle)));
+    if (handle == nullptr) {
+        return nullptr;
+    }
+    handle->fd = -1;
+    handle->width = static_cast<int32_t>(info.width);
+    handle->stride = static_cast<int32_t>(stride);
+    handle->height = static_cast<int32_t>(info.height);
+    handle->size = static_cast<int32_t>(total);
+    handle->format = info.format;
+    handle->usage = info.usage;
+    handle->key = -1;
+    size = static_cast<uint32_t>(total);
+    return handle;
+}
+
+void* LocalAllocator::Mmap(BufferHandle* handle)
+{
+    return handle->virAddr;
+}
+
+void* LocalAllocator::MmapCache(BufferHandle* handle)
+{
+    return handle->virAddr;
+}
+
+int32_t LocalAllocator::Unmap(BufferHandle* handle)
+{
+    /* the mapping is released by FreeMem */
+    return DISPLAY_SUCCESS;
+}
+
+int32_t LocalAllocator::FlushCache(BufferHandle* handle)
+{
+    return DISPLAY_SUCCESS;
+}
+
+int32_t LocalAllocator::FlushMCache(BufferHandle* handle)
+{
+    return DISPLAY_SUCCESS;
+}
+
+int32_t LocalAllocator::InvalidateCache(BufferHandle* handle)
+{
+    return DISPLAY_SUCCESS;
+}
+
+int32_t MemfdAllocator::AllocMem(const AllocInfo& info, BufferHandle** handle)
+{
+#ifdef __NR_memfd_create
+    uint32_t size = 0;
+    BufferHandle* bufferHandle = CreateHandle(info, size);
+    if (bufferHandle == nullptr) {
+        return DISPLAY_FAILURE;
+    }
+    void* virAddr = MAP_FAILED;
+    int32_t fd = static_cast<int32_t>(syscall(__NR_memfd_create, "surface_buffer", MFD_CLOEXEC));
+    if (fd < 0) {
+        GRAPHIC_LOGE("memfd create failed.");
+        goto ERROR;
+    }
+    if (ftruncate(fd, size) != 0) {
+        GRAPHIC_LOGE("memfd truncate failed.");
+        goto ERROR;
+    }
+    virAddr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (virAddr == MAP_FAILED) {
+        GRAPHIC_LOGE("memfd map failed.");
+        goto ERROR;
+    }
+    bufferHandle->fd = fd;
+    bufferHandle->key = fd;
+    bufferHandle->virAddr = virAddr;
+    bufferHandle->phyAddr = reinterpret_cast<uintptr_t>(virAddr);
+    *handle = bufferHandle;
+    return DISPLAY_SUCCESS;
+ERROR:
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(bufferHandle);
+    return DISPLAY_FAILURE;
+#else
+    GRAPHIC_LOGE("memfd is not supported.");
+    return DISPLAY_FAILURE;
+#endif
+}
+
+void MemfdAllocator::FreeMem(BufferHandle* handle)
+{
+    munmap(handle->virAddr, handle->size);
+    close(handle->fd);
+    free(handle);
+}
+
+int32_t AnonymousAllocator::AllocMem(const AllocInfo& info, BufferHandle** handle)
+{
+    uint32_t size = 0;
+    BufferHandle* bufferHandle = CreateHandle(info, size);
+    if (bufferHandle == nullptr) {
+        return DISPLAY_FAILURE;
+    }
+    void* virAddr = nullptr;
+    if (posix_memalign(&virAddr, LOCAL_ADDR_ALIGNMENT, size) != 0) {
+        GRAPHIC_LOGE("Alloc anonymous memory failed.");
+        free(bufferHandle);
+        return DISPLAY_FAILURE;
+    }
+    bufferHandle->virAddr = virAddr;
+    bufferHandle->phyAddr = reinterpret_cast<uintptr_t>(virAddr);
+    *handle = bufferHandle;
+    return DISPLAY_SUCCESS;
+}
+
+void AnonymousAllocator::FreeMem(BufferHandle* handle)
+{
+    free(handle->virAddr);
+    free(handle);
+}
+
+static size_t GetHugePageLength(const BufferHandle* handle)
+{
+    uint64_t size = static_cast<uint64_t>(handle->size);
+    return static_cast<size_t>((size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+}
+
+int32_t HugePageAllocator::AllocMem(const AllocInfo& info, BufferHandle** handle)
+{
+    uint32_t size = 0;
+    BufferHandle* bufferHandle = CreateHandle(info, size);
+    if (bufferHandle == nullptr) {
+        return DISPLAY_FAILURE;
+    }
+    size_t length = GetHugePageLength(bufferHandle);
+    void* virAddr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    virAddr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (virAddr == MAP_FAILED) {
+        /* no reserved huge pages, use transparent huge pages if the kernel supports. */
+        virAddr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (virAddr == MAP_FAILED) {
+            GRAPHIC_LOGE("Map huge page memory failed.");
+            free(bufferHandle);
+            return DISPLAY_FAILURE;
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(virAddr, length, MADV_HUGEPAGE);
+#endif
+    }
+    bufferHandle->virAddr = virAddr;
+    bufferHandle->phyAddr = reinterpret_cast<uintptr_t>(virAddr);
+    *handle = bufferHandle;
+    return DISPLAY_SUCCESS;
+}
+
+void HugePageAllocator::FreeMem(BufferHandle* handle)
+{
+    munmap(handle->virAddr, GetHugePageLength(handle));
+    free(handle);
+}
+
+uint32_t HugePageAllocator::GetFootprint(const BufferHandle* handle)
+{
+    /* A small buffer still takes a whole huge page. */
+    return static_cast<uint32_t>(GetHugePageLength(handle));
+}
+
+uint32_t HugePageAllocator::EstimateFootprint(const AllocInfo& info)
+{
+    uint64_t size = LocalAllocator::EstimateFootprint(info);
+    return static_cast<uint32_t>((size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+}
+} // namespace OHOS
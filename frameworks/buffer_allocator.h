@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GRAPHIC_LITE_BUFFER_ALLOCATOR_H
+#define GRAPHIC_LITE_BUFFER_ALLOCATOR_H
+
+#include "display_gralloc.h"
+
+namespace OHOS {
+/**
+ * @brief Type of the built-in buffer allocator backends.
+ */
+enum BufferAllocatorType {
+    BUFFER_ALLOCATOR_GRALLOC = 0, /* display gralloc, buffers could be shared with other processes */
+    BUFFER_ALLOCATOR_MEMFD,       /* memfd mapped with MAP_SHARED */
+    BUFFER_ALLOCATOR_ANONYMOUS,   /* heap memory, for surfaces used only in this process */
+    BUFFER_ALLOCATOR_HUGE_PAGE,   /* huge page backed anonymous mapping, for large buffers */
+    BUFFER_ALLOCATOR_MAX
+};
+
+/**
+ * @brief Buffer allocator abstract class. The backend of BufferManager to alloc, free, map and maintain the
+ *        cache of buffer memory. The functions follow the semantics of gralloc, and return DISPLAY_SUCCESS
+ *        or DISPLAY_FAILURE.
+ *        Buffers of the memfd, anonymous and huge page backends are mapped when allocated, and are identified
+ *        by the key -1 (or the memfd) and the virtual address stored as physical address. They are only
+ *        used in this process, since buffers are shared with other processes by gralloc key.
+ */
+class BufferAllocator {
+public:
+    virtual ~BufferAllocator() {}
+
+    /**
+     * @brief Get the built-in allocator. The allocators are process-wide and never destroyed.
+     * @param [in] type, the type of the allocator.
+     * @returns BufferAllocator pointer, nullptr if the backend is not supported.
+     */
+    static BufferAllocator* GetBuiltin(BufferAllocatorType type);
+
+    /**
+     * @brief Allocate buffer memory.
+     * @param [in] info, width, height, format, usage and expected size of the buffer.
+     * @param [out] handle, the allocated buffer handle.
+     * @returns DISPLAY_SUCCESS is succeed; other is failed.
+     */
+    virtual int32_t AllocMem(const AllocInfo& info, BufferHandle** handle) = 0;
+
+    /**
+     * @brief Free buffer memory and the handle.
+     * @param [in] handle, allocated by AllocMem.
+     */
+    virtual void FreeMem(BufferHandle* handle) = 0;
+
+    /**
+     * @brief Get the memory held by the handle, which is counted against the memory budget and cache budget.
+     * @param [in] handle, allocated by AllocMem.
+     * @returns The size in bytes, the size of the handle by default.
+     */
+    virtual uint32_t GetFootprint(const BufferHandle* handle);
+
+    /**
+     * @brief Estimate the memory a buffer will hold before it is allocated, to reserve the memory budget.
+     * @param [in] info, width, height, format, usage and expected size of the buffer.
+     * @returns The size in bytes, the size of unpadded rows by default. 0 if the info is invalid.
+     */
+    virtual uint32_t EstimateFootprint(const AllocInfo& info);
+
+    /**
+     * @brief Map buffer memory.
+     * @param [in] handle, the buffer handle.
+     * @returns The virtual address, nullptr is failed.
+     */
+    virtual void* Mmap(BufferHandle* handle) = 0;
+
+    /**
+     * @brief Map buffer memory with cache.
+     * @param [in] handle, the buffer handle.
+     * @returns The virtual address, nullptr is failed.
+     */
+    virtual void* MmapCache(BufferHandle* handle) = 0;
+
+    /**
+     * @brief Unmap buffer memory mapped by Mmap or MmapCache.
+     * @param [in] handle, the buffer handle.
+     * @returns DISPLAY_SUCCESS is succeed; other is failed.
+     */
+    virtual int32_t Unmap(BufferHandle* handle) = 0;
+
+    /**
+     * @brief Flush the cache of buffer memory mapped by Mmap.
+     * @param [in] handle, the buffer handle.
+     * @returns DISPLAY_SUCCESS is succeed; other is failed.
+     */
+    virtual int32_t FlushCache(BufferHandle* handle) = 0;
+
+    /**
+     * @brief Flush the cache of buffer memory mapped by MmapCache.
+     * @param [in] handle, the buffer handle.
+     * @returns DISPLAY_SUCCESS is succeed; other is failed.
+     */
+    virtual int32_t FlushMCache(BufferHandle* handle) = 0;
+
+    /**
+     * @brief Invalidate the cache of buffer memory.
+     * @param [in] handle, the buffer handle.
+     * @returns DISPLAY_SUCCESS is succeed; other is failed.
+     */
+    virtual int32_t InvalidateCache(BufferHandle* handle) = 0;
+};
+
+/**
+ * @brief Allocator backed by display gralloc.
+ */
+class GrallocAllocator : public BufferAllocator {
+public:
+    explicit GrallocAllocator(GrallocFuncs* grallocFuncs) : grallocFuncs_(grallocFuncs) {}
+    ~GrallocAllocator() override {}
+    int32_t AllocMem(const AllocInfo& info, BufferHandle** handle) override;
+    void FreeMem(BufferHandle* handle) override;
+    void* Mmap(BufferHandle* handle) override;
+    void* MmapCache(BufferHandle* handle) override;
+    int32_t Unmap(BufferHandle* handle) override;
+    int32_t FlushCache(BufferHandle* handle) override;
+    int32_t FlushMCache(BufferHandle* handle) override;
+    int32_t InvalidateCache(BufferHandle* handle) override;
+
+private:
+    GrallocFuncs* grallocFuncs_;
+};
+
+/**
+ * @brief Base of the allocators whose buffers are mapped when allocated and coherent with CPU,
+ *        so map returns the existing mapping and cache maintenance does nothing.
+ */
+class LocalAllocator : public BufferAllocator {
+public:
+    ~LocalAllocator() override {}
+    void* Mmap(BufferHandle* handle) override;
+    void* MmapCache(BufferHandle* handle) override;
+    int32_t Unmap(BufferHandle* handle) override;
+    int32_t FlushCache(BufferHandle* handle) override;
+    int32_t FlushMCache(BufferHandle* handle) override;
+    int32_t InvalidateCache(BufferHandle* handle) override;
+    uint32_t EstimateFootprint(const AllocInfo& info) override;
+
+protected:
+    static BufferHandle* CreateHandle(const AllocInfo& info, uint32_t& size);
+};
+
+/**
+ * @brief Allocator backed by memfd mapped with MAP_SHARED. The memfd is kept in the fd of the handle.
+ */
+class MemfdAllocator : public LocalAllocator {
+public:
+    ~MemfdAllocator() override {}
+    int32_t AllocMem(const AllocInfo& info, BufferHandle** handle) override;
+    void FreeMem(BufferHandle* handle) override;
+};
+
+/**
+ * @brief Allocator backed by heap memory.
+ */
+class AnonymousAllocator : public LocalAllocator {
+public:
+    ~AnonymousAllocator() override {}
+    int32_t AllocMem(const AllocInfo& info, BufferHandle** handle) override;
+    void FreeMem(BufferHandle* handle) override;
+};
+
+/**
+ * @brief Allocator backed by huge pages. The size is rounded up to the huge page size, if huge pages are not
+ *        reserved, falls back to a normal mapping advised for transparent huge pages.
+ */
+class HugePageAllocator : public LocalAllocator {
+public:
+    ~HugePageAllocator() override {}
+    int32_t AllocMem(const AllocInfo& info, BufferHandle** handle) override;
+    void FreeMem(BufferHandle* handle) override;
+    uint32_t GetFootprint(const BufferHandle* handle) override;
+    uint32_t EstimateFootprint(const AllocInfo& info) override;
+};
+} // end namespace
+#endif
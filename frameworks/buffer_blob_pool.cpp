@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "buffer_blob_pool.h"
+
+#include <cstdlib>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "buffer_common.h"
+#include "securec.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+namespace OHOS {
+static const uint32_t BLOB_CLASS_SIZES[] = {64, 256, 1024, 4096};
+
+BlobPool* BlobPool::Create()
+{
+    return new BlobPool();
+}
+
+BlobPool::BlobPool() : refCount_(1)
+{
+    for (uint32_t i = 0; i < BLOB_CLASS_NUM; i++) {
+        freeLists_[i] = nullptr;
+        freeCounts_[i] = 0;
+    }
+    pthread_mutex_init(&lock_, nullptr);
+}
+
+BlobPool::~BlobPool()
+{
+    for (uint32_t i = 0; i < BLOB_CLASS_NUM; i++) {
+        while (freeLists_[i] != nullptr) {
+            BlobHeader* header = freeLists_[i];
+            freeLists_[i] = header->next;
+            free(header);
+        }
+    }
+    pthread_mutex_destroy(&lock_);
+}
+
+void BlobPool::Ref()
+{
+    pthread_mutex_lock(&lock_);
+    refCount_++;
+    pthread_mutex_unlock(&lock_);
+}
+
+void BlobPool::Unref()
+{
+    pthread_mutex_lock(&lock_);
+    bool destroy = (--refCount_ == 0);
+    pthread_mutex_unlock(&lock_);
+    if (destroy) {
+        delete this;
+    }
+}
+
+void BlobPool::Release()
+{
+    Unref();
+}
+
+BlobPool::BlobHeader* BlobPool::GetHeader(const void* blob)
+{
+    return reinterpret_cast<BlobHeader*>(const_cast<uint8_t*>(static_cast<const uint8_t*>(blob))) - 1;
+}
+
+void* BlobPool::Alloc(BlobPool* pool, uint32_t size)
+{
+    uint32_t index = 0;
+    while (index < BLOB_CLASS_NUM && BLOB_CLASS_SIZES[index] < size) {
+        index++;
+    }
+    uint32_t capacity = (index < BLOB_CLASS_NUM) ? BLOB_CLASS_SIZES[index] : size;
+    BlobHeader* header = nullptr;
+    if (pool != nullptr && index < BLOB_CLASS_NUM) {
+        pthread_mutex_lock(&pool->lock_);
+        header = pool->freeLists_[index];
+        if (header != nullptr) {
+            pool->freeLists_[index] = header->next;
+            pool->freeCounts_[index]--;
+        }
+        pthread_mutex_unlock(&pool->lock_);
+    }
+    if (header == nullptr) {
+        header = static_cast<BlobHeader*>(malloc(sizeof(BlobHeader) + capacity));
+        if (header == nullptr) {
+            GRAPHIC_LOGE("Alloc blob of %u bytes failed.", size);
+            return nullptr;
+        }
+        header->capacity = capacity;
+    }
+    if (pool != nullptr) {
+        pool->Ref();
+    }
+    header->pool = pool;
+    header->next = nullptr;
+    header->fd = -1;
+    return header + 1;
+}
+
+void BlobPool::Free(void* blob)
+{
+    if (blob == nullptr) {
+        return;
+    }
+    Invalidate(blob);
+    BlobHeader* header = GetHeader(blob);
+    BlobPool* pool = header->pool;
+    if (pool == nullptr) {
+        free(header);
+        return;
+    }
+    uint32_t index = 0;
+    while (index < BLOB_CLASS_NUM && BLOB_CLASS_SIZES[index] != header->capacity) {
+        index++;
+    }
+    pthread_mutex_lock(&pool->lock_);
+    if (index < BLOB_CLASS_NUM && pool->freeCounts_[index] < BLOB_CLASS_FREE_MAX) {
+        header->next = pool->freeLists_[index];
+        pool->freeLists_[index] = header;
+        pool->freeCounts_[index]++;
+        header = nullptr;
+    }
+    pthread_mutex_unlock(&pool->lock_);
+    free(header);
+    pool->Unref();
+}
+
+uint32_t BlobPool::GetCapacity(const void* blob)
+{
+    return GetHeader(blob)->capacity;
+}
+
+int32_t BlobPool::GetSharedFd(void* blob, uint32_t size)
+{
+    BlobHeader* header = GetHeader(blob);
+    if (header->fd >= 0) {
+        return header->fd;
+    }
+#ifdef __NR_memfd_create
+    int32_t fd = static_cast<int32_t>(syscall(__NR_memfd_create, "surface_blob", MFD_CLOEXEC));
+    if (fd < 0) {
+        GRAPHIC_LOGE("memfd create failed.");
+        return -1;
+    }
+    if (pwrite(fd, blob, size, 0) != static_cast<ssize_t>(size)) {
+        GRAPHIC_LOGE("Write blob to shared memory failed.");
+        close(fd);
+        return -1;
+    }
+    header->fd = fd;
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+void BlobPool::Invalidate(void* blob)
+{
+    BlobHeader* header = GetHeader(blob);
+    if (header->fd >= 0) {
+        close(header->fd);
+        header->fd = -1;
+    }
+}
+
+bool BlobPool::ReadSharedFd(int32_t fd, void* blob, uint32_t size)
+{
+    if (fd < 0) {
+        return false;
+    }
+    bool ret = (pread(fd, blob, size, 0) == static_cast<ssize_t>(size));
+    close(fd);
+    return ret;
+}
+} // namespace OHOS
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GRAPHIC_LITE_BUFFER_BLOB_POOL_H
+#define GRAPHIC_LITE_BUFFER_BLOB_POOL_H
+
+#include <cstdint>
+#include <pthread.h>
+
+namespace OHOS {
+/* Blobs not larger than it are copied into ipc object, larger ones are passed by shared memory. */
+const uint32_t BLOB_IPC_INLINE_SIZE = 32;
+
+/**
+ * @brief Blob pool. Recycles the memory of blob extra data of the buffers of a queue, so that setting blobs
+ *        every frame does not allocate from heap. Blobs are allocated in size classes, larger blobs are
+ *        allocated from heap directly. A blob remembers its pool, the pool is destroyed after it is released
+ *        by the owner and all its blobs are freed.
+ */
+class BlobPool {
+public:
+    /**
+     * @brief Create a blob pool, owned by the caller.
+     * @returns BlobPool pointer.
+     */
+    static BlobPool* Create();
+
+    /**
+     * @brief Release the blob pool by the owner.
+     */
+    void Release();
+
+    /**
+     * @brief Allocate a blob.
+     * @param [in] BlobPool pointer, nullptr is allocate from heap.
+     * @param [in] size, the size of the blob.
+     * @returns The blob, nullptr if failed.
+     */
+    static void* Alloc(BlobPool* pool, uint32_t size);
+
+    /**
+     * @brief Free the blob to its pool.
+     * @param [in] blob, allocated by Alloc.
+     */
+    static void Free(void* blob);
+
+    /**
+     * @brief Get the capacity of the blob.
+     * @param [in] blob, allocated by Alloc.
+     * @returns The capacity, not less than the allocated size.
+     */
+    static uint32_t GetCapacity(const void* blob);
+
+    /**
+     * @brief Get the shared memory fd holding the content of the blob, created on the first call after the blob
+     *        changes. The fd is owned by the blob, and closed when the blob is freed or changed.
+     * @param [in] blob, allocated by Alloc.
+     * @param [in] size, the size of the content.
+     * @returns The fd, -1 if shared memory is not supported.
+     */
+    static int32_t GetSharedFd(void* blob, uint32_t size);
+
+    /**
+     * @brief Notify the content of the blob is changed, the shared memory fd is closed.
+     * @param [in] blob, allocated by Alloc.
+     */
+    static void Invalidate(void* blob);
+
+    /**
+     * @brief Read the content of shared memory and close the fd.
+     * @param [in] fd, the shared memory fd received from other process.
+     * @param [out] blob, the destination.
+     * @param [in] size, the size to read.
+     * @returns Whether read succeed or not.
+     */
+    static bool ReadSharedFd(int32_t fd, void* blob, uint32_t size);
+
+private:
+    BlobPool();
+    ~BlobPool();
+    void Ref();
+    void Unref();
+
+    struct BlobHeader {
+        BlobPool* pool;
+        BlobHeader* next; /* next free blob of the size class */
+        uint32_t capacity;
+        int32_t fd;
+        uint64_t reserved; /* keep content 16 bytes aligned */
+    };
+    static BlobHeader* GetHeader(const void* blob);
+    static const uint32_t BLOB_CLASS_NUM = 4;
+    static const uint32_t BLOB_CLASS_FREE_MAX = 16;
+    BlobHeader* freeLists_[BLOB_CLASS_NUM];
+    uint32_t freeCounts_[BLOB_CLASS_NUM];
+    uint32_t refCount_; /* owner and allocated blobs */
+    pthread_mutex_t lock_;
+};
+} // end namespace
+#endif
@@ -16,19 +16,257 @@
 #include "buffer_client_producer.h"
 #include "ipc_skeleton.h"
 
+#include "buffer_blob_pool.h"
 #include "buffer_common.h"
 #include "buffer_manager.h"
 #include "buffer_queue.h"
+#include "securec.h"
 #include "surface_buffer_impl.h"
 
 namespace OHOS {
 const int32_t DEFAULT_IPC_SIZE = 200;
-BufferClientProducer::BufferClientProducer(const SvcIdentity& sid) : sid_(sid)
+const int32_t BUFFER_IPC_SIZE = 1024; /* buffer attr, extra data and frame metadata */
+BufferClientProducer::BufferClientProducer(const SvcIdentity& sid)
+    : sid_(sid), generation_(0), blobPool_(BlobPool::Create()), configValid_(false), configEpoch_(0),
+      async_(false), producerListener_(nullptr)
 {
+    pthread_mutex_init(&lock_, nullptr);
 }
 
 BufferClientProducer::~BufferClientProducer()
 {
+    pthread_mutex_lock(&lock_);
+    std::list<ProxyBuffer>::iterator iter;
+    for (iter = proxyBuffers_.begin(); iter != proxyBuffers_.end(); ++iter) {
+        ReleaseProxyBuffer(iter->buffer);
+    }
+    proxyBuffers_.clear();
+    pthread_mutex_unlock(&lock_);
+    pthread_mutex_destroy(&lock_);
+    blobPool_->Release();
+}
+
+void BufferClientProducer::ReleaseProxyBuffer(SurfaceBufferImpl* buffer)
+{
+    BufferManager* manager = BufferManager::GetInstance();
+    if (manager != nullptr) {
+        manager->UnmapBuffer(*buffer);
+    }
+    delete buffer;
+}
+
+SurfaceBufferImpl* BufferClientProducer::GetProxyBuffer(SurfaceBufferImpl& buffer, uint32_t generation)
+{
+    pthread_mutex_lock(&lock_);
+    std::list<ProxyBuffer>::iterator iter = proxyBuffers_.begin();
+    if (generation != generation_) {
+        /* buffers are reallocated or freed by BufferQueue, drop the idle mappings which may be stale. */
+        while (iter != proxyBuffers_.end()) {
+            if (iter->held) {
+                ++iter;
+                continue;
+            }
+            ReleaseProxyBuffer(iter->buffer);
+            iter = proxyBuffers_.erase(iter);
+        }
+        generation_ = generation;
+    }
+    SurfaceBufferImpl* proxy = nullptr;
+    for (iter = proxyBuffers_.begin(); iter != proxyBuffers_.end(); ++iter) {
+        if (!iter->held && iter->buffer->GetKey() == buffer.GetKey() &&
+            iter->buffer->GetPhyAddr() == buffer.GetPhyAddr()) {
+            proxy = iter->buffer;
+            iter->held = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock_);
+
+    bool mapped = (proxy != nullptr);
+    if (proxy == nullptr) {
+        proxy = new SurfaceBufferImpl();
+        proxy->SetBlobPool(blobPool_);
+        proxy->SetKey(buffer.GetKey());
+        proxy->SetPhyAddr(buffer.GetPhyAddr());
+    }
+    proxy->SetSlot(buffer.GetSlot());
+    proxy->SetStride(buffer.GetStride());
+    proxy->SetReserve(buffer.GetReserve(), buffer.GetReserveFds(), buffer.GetReserveInts());
+    proxy->SetMaxSize(buffer.GetMaxSize());
+    proxy->SetUsage(buffer.GetUsage());
+    proxy->CopyPlanes(buffer);
+    proxy->SetCpuCacheFlushed(false);
+    proxy->ClearExtraData();
+    proxy->MoveExtraData(buffer);
+    if (mapped) {
+        return proxy;
+    }
+
+    BufferManager* manager = BufferManager::GetInstance();
+    if ((manager == nullptr) || !manager->MapBuffer(*proxy)) {
+        GRAPHIC_LOGW("Map buffer failed, usage(%d)", proxy->GetUsage());
+        delete proxy;
+        return nullptr;
+    }
+    ProxyBuffer entry = {proxy, generation, true};
+    pthread_mutex_lock(&lock_);
+    proxyBuffers_.push_back(entry);
+    pthread_mutex_unlock(&lock_);
+    return proxy;
+}
+
+SurfaceBufferImpl* BufferClientProducer::GetSlotProxyBuffer(uint32_t slot, int32_t key, uint32_t generation)
+{
+    SurfaceBufferImpl* proxy = nullptr;
+    pthread_mutex_lock(&lock_);
+    std::list<ProxyBuffer>::iterator iter;
+    for (iter = proxyBuffers_.begin(); iter != proxyBuffers_.end(); ++iter) {
+        if (!iter->held && (iter->generation == generation) && (iter->buffer->GetSlot() == slot) &&
+            (iter->buffer->GetKey() == key)) {
+            proxy = iter->buffer;
+            iter->held = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock_);
+    if (proxy != nullptr) {
+        proxy->SetCpuCacheFlushed(false);
+        proxy->ClearExtraData();
+    }
+    return proxy;
+}
+
+void BufferClientProducer::ReturnProxyBuffer(SurfaceBufferImpl* buffer, bool valid, uint32_t generation)
+{
+    pthread_mutex_lock(&lock_);
+    std::list<ProxyBuffer>::iterator iter;
+    for (iter = proxyBuffers_.begin(); iter != proxyBuffers_.end(); ++iter) {
+        if (iter->buffer == buffer) {
+            break;
+        }
+    }
+    if ((iter != proxyBuffers_.end()) && valid && (iter->generation == generation)) {
+        iter->held = false;
+        buffer->ClearExtraData();
+        pthread_mutex_unlock(&lock_);
+        return;
+    }
+    if (iter != proxyBuffers_.end()) {
+        proxyBuffers_.erase(iter);
+    }
+    pthread_mutex_unlock(&lock_);
+    ReleaseProxyBuffer(buffer);
+}
+
+void BufferClientProducer::ReadGenerations(IpcIo& reply, uint32_t& generation)
+{
+    uint32_t configGeneration = 0;
+    int32_t asyncError = SURFACE_ERROR_OK;
+    ReadUint32(&reply, &generation);
+    ReadUint32(&reply, &configGeneration);
+    ReadInt32(&reply, &asyncError);
+    pthread_mutex_lock(&lock_);
+    if (configValid_ && (config_.generation != configGeneration)) {
+        configValid_ = false;
+    }
+    pthread_mutex_unlock(&lock_);
+    if (asyncError != SURFACE_ERROR_OK) {
+        ReportAsyncError(asyncError);
+    }
+}
+
+void BufferClientProducer::ReportAsyncError(int32_t error)
+{
+    pthread_mutex_lock(&lock_);
+    IBufferProducerListener* listener = producerListener_;
+    pthread_mutex_unlock(&lock_);
+    if (listener == nullptr) {
+        GRAPHIC_LOGW("Async flush or cancel failed code=%d", error);
+        return;
+    }
+    listener->OnAsyncError(error);
+}
+
+void BufferClientProducer::SetAsyncMode(bool async)
+{
+    pthread_mutex_lock(&lock_);
+    async_ = async;
+    pthread_mutex_unlock(&lock_);
+}
+
+bool BufferClientProducer::IsAsync()
+{
+    pthread_mutex_lock(&lock_);
+    bool async = async_;
+    pthread_mutex_unlock(&lock_);
+    return async;
+}
+
+void BufferClientProducer::RegisterProducerListener(IBufferProducerListener& listener)
+{
+    pthread_mutex_lock(&lock_);
+    producerListener_ = &listener;
+    pthread_mutex_unlock(&lock_);
+}
+
+void BufferClientProducer::UnregisterProducerListener()
+{
+    pthread_mutex_lock(&lock_);
+    producerListener_ = nullptr;
+    pthread_mutex_unlock(&lock_);
+}
+
+void BufferClientProducer::InvalidateConfig()
+{
+    pthread_mutex_lock(&lock_);
+    configValid_ = false;
+    configEpoch_++;
+    pthread_mutex_unlock(&lock_);
+}
+
+bool BufferClientProducer::GetConfig(BufferQueueConfig& config)
+{
+    pthread_mutex_lock(&lock_);
+    if (configValid_) {
+        config = config_;
+        pthread_mutex_unlock(&lock_);
+        return true;
+    }
+    uint32_t epoch = configEpoch_;
+    pthread_mutex_unlock(&lock_);
+
+    IpcIo requestIo;
+    uint8_t requestIoData[DEFAULT_IPC_SIZE];
+    IpcIoInit(&requestIo, requestIoData, DEFAULT_IPC_SIZE, 0);
+    IpcIo reply;
+    uintptr_t ptr;
+    MessageOption option;
+    MessageOptionInit(&option);
+    int32_t ret = SendRequest(sid_, GET_CONFIG, &requestIo, &reply, option, &ptr);
+    if (ret != SURFACE_ERROR_OK) {
+        GRAPHIC_LOGW("GetConfig SendRequest failed, errno=%d", ret);
+        return false;
+    }
+    ReadInt32(&reply, &ret);
+    uint32_t length = 0;
+    ReadUint32(&reply, &length);
+    const void* data = ReadBuffer(&reply, length);
+    /* Newer versions append attributes, which are ignored. */
+    if ((ret != SURFACE_ERROR_OK) || (data == nullptr) || (length < sizeof(config)) ||
+        (memcpy_s(&config, sizeof(config), data, sizeof(config)) != EOK)) {
+        GRAPHIC_LOGW("GetConfig failed code=%d", ret);
+        FreeBuffer(reinterpret_cast<void *>(ptr));
+        return false;
+    }
+    FreeBuffer(reinterpret_cast<void *>(ptr));
+    pthread_mutex_lock(&lock_);
+    /* Attributes set by this producer during the request may be missed, the snapshot is not kept then. */
+    if (epoch == configEpoch_) {
+        config_ = config;
+        configValid_ = true;
+    }
+    pthread_mutex_unlock(&lock_);
+    return true;
 }
 
 SurfaceBufferImpl* BufferClientProducer::RequestBuffer(uint8_t wait)
@@ -37,6 +275,7 @@ SurfaceBufferImpl* BufferClientProducer::RequestBuffer(uint8_t wait)
     uint8_t requestIoData[DEFAULT_IPC_SIZE];
     IpcIoInit(&requestIo, requestIoData, DEFAULT_IPC_SIZE, 0);
     WriteUint8(&requestIo, wait);
+    WriteKnownSlots(requestIo);
     IpcIo reply;
     uintptr_t ptr;
     MessageOption option;
@@ -52,72 +291,178 @@ SurfaceBufferImpl* BufferClientProducer::RequestBuffer(uint8_t wait)
         FreeBuffer(reinterpret_cast<void *>(ptr));
         return nullptr;
     }
+    uint32_t generation = 0;
+    ReadGenerations(reply, generation);
+    SurfaceBufferImpl* proxy = ReadRequestedBuffer(reply, generation);
+    FreeBuffer(reinterpret_cast<void *>(ptr));
+    return proxy;
+}
 
-    SurfaceBufferImpl* buffer = new SurfaceBufferImpl();
-    buffer->ReadFromIpcIo(reply);
-    BufferManager* manager = BufferManager::GetInstance();
-    if (manager == nullptr) {
-        GRAPHIC_LOGW("BufferManager is null, usage(%d)", buffer->GetUsage());
-        delete buffer;
-        FreeBuffer(reinterpret_cast<void *>(ptr));
-        return nullptr;
+void BufferClientProducer::WriteKnownSlots(IpcIo& io)
+{
+    uint32_t slots = 0;
+    pthread_mutex_lock(&lock_);
+    uint32_t generation = generation_;
+    std::list<ProxyBuffer>::iterator iter;
+    for (iter = proxyBuffers_.begin(); iter != proxyBuffers_.end(); ++iter) {
+        uint32_t slot = iter->buffer->GetSlot();
+        if ((iter->generation == generation) && (slot < BUFFER_SLOT_MAX)) {
+            slots |= (1u << slot);
+        }
     }
+    pthread_mutex_unlock(&lock_);
+    WriteUint32(&io, generation);
+    WriteUint32(&io, slots);
+}
 
-    if (!manager->MapBuffer(*buffer)) {
-        Cancel(buffer);
-        FreeBuffer(reinterpret_cast<void *>(ptr));
+SurfaceBufferImpl* BufferClientProducer::ReadRequestedBuffer(IpcIo& reply, uint32_t generation)
+{
+    uint32_t slot = BUFFER_SLOT_INVALID;
+    int32_t key = 0;
+    bool whole = true;
+    ReadUint32(&reply, &slot);
+    ReadInt32(&reply, &key);
+    ReadBool(&reply, &whole);
+    SurfaceBufferImpl buffer;
+    buffer.SetBlobPool(blobPool_);
+    if (!whole) {
+        SurfaceBufferImpl* proxy = GetSlotProxyBuffer(slot, key, generation);
+        if (proxy != nullptr) {
+            return proxy;
+        }
+        /* the mapping is dropped meanwhile by another reply, give the buffer back. */
+        GRAPHIC_LOGW("RequestBuffer slot(%u) is not mapped", slot);
+        buffer.SetSlot(slot);
+        buffer.SetKey(key);
+        SendCancel(buffer, generation);
         return nullptr;
     }
-    FreeBuffer(reinterpret_cast<void *>(ptr));
-    return buffer;
+    if (!buffer.ReadFromIpcIo(reply)) {
+        GRAPHIC_LOGW("RequestBuffer reply is invalid");
+        return nullptr;
+    }
+    buffer.SetSlot(slot);
+    SurfaceBufferImpl* proxy = GetProxyBuffer(buffer, generation);
+    if (proxy == nullptr) {
+        SendCancel(buffer, generation);
+        return nullptr;
+    }
+    return proxy;
 }
 
 int32_t BufferClientProducer::FlushBuffer(SurfaceBufferImpl* buffer)
+{
+    return Flush(buffer, nullptr, 0);
+}
+
+int32_t BufferClientProducer::FlushAndRequestBuffer(SurfaceBufferImpl* buffer, SurfaceBufferImpl*& next, uint8_t wait)
+{
+    next = nullptr;
+    return Flush(buffer, &next, wait);
+}
+
+int32_t BufferClientProducer::Flush(SurfaceBufferImpl* buffer, SurfaceBufferImpl** next, uint8_t wait)
 {
     RETURN_VAL_IF_FAIL(buffer, -1);
     BufferManager* manager = BufferManager::GetInstance();
     RETURN_VAL_IF_FAIL(manager, -1);
     int32_t ret = SURFACE_ERROR_OK;
-    if (buffer->GetUsage() == BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE) {
+    if (buffer->GetUsage() == BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE && !buffer->IsCpuCacheFlushed()) {
         ret = manager->FlushCache(*buffer);
         if (ret != SURFACE_ERROR_OK) {
             GRAPHIC_LOGW("Flush buffer failed, ret=%d", ret);
             return ret;
         }
     }
+    if ((next == nullptr) && IsAsync()) {
+        uint32_t generation = 0;
+        ret = SendOneWay(FLUSH_BUFFER, *buffer, generation);
+        /* all keys are sent one-way, the baseline could not be confirmed by the queue. */
+        buffer->ResetIpcBaseline();
+        if (ret != SURFACE_ERROR_OK) {
+            GRAPHIC_LOGW("FlushBuffer one-way failed code=%d", ret);
+            return -1;
+        }
+        ReturnProxyBuffer(buffer, true, generation);
+        return ret;
+    }
+    ret = SendFlush(*buffer, next, wait);
+    if ((ret == SURFACE_ERROR_DATA_STALE) ||
+        ((ret == SURFACE_ERROR_BUFFER_NOT_EXISTED) && (buffer->GetSlot() != BUFFER_SLOT_INVALID))) {
+        /*
+         * the queue lost the extra data last sent, e.g. the buffer is reallocated, or the buffer is moved to
+         * other slot, send the whole buffer and all keys again.
+         */
+        buffer->ResetIpcBaseline();
+        buffer->SetSlot(BUFFER_SLOT_INVALID);
+        ret = SendFlush(*buffer, next, wait);
+    }
+    if (ret != SURFACE_ERROR_OK) {
+        GRAPHIC_LOGW("FlushBuffer failed code=%d", ret);
+        buffer->ResetIpcBaseline();
+        return -1;
+    }
+    return ret;
+}
+
+int32_t BufferClientProducer::SendFlush(SurfaceBufferImpl& buffer, SurfaceBufferImpl** next, uint8_t wait)
+{
     IpcIo requestIo;
-    uint8_t requestIoData[DEFAULT_IPC_SIZE];
-    IpcIoInit(&requestIo, requestIoData, DEFAULT_IPC_SIZE, 0);
-    buffer->WriteToIpcIo(requestIo);
+    uint8_t requestIoData[BUFFER_IPC_SIZE];
+    IpcIoInit(&requestIo, requestIoData, BUFFER_IPC_SIZE, 0);
+    if (next != nullptr) {
+        WriteUint8(&requestIo, wait);
+        WriteKnownSlots(requestIo);
+    }
+    WriteBufferRef(requestIo, buffer);
+    /* Producers usually set the same keys every frame, only the changes since last flush are sent. */
+    if (!buffer.WriteExtraDataToIpcIo(requestIo, true)) {
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
     IpcIo reply;
     uintptr_t ptr;
     MessageOption option;
     MessageOptionInit(&option);
-    ret = SendRequest(sid_, FLUSH_BUFFER, &requestIo, &reply, option, &ptr);
+    uint32_t code = (next != nullptr) ? FLUSH_AND_REQUEST : FLUSH_BUFFER;
+    int32_t ret = SendRequest(sid_, code, &requestIo, &reply, option, &ptr);
     if (ret != SURFACE_ERROR_OK) {
-        GRAPHIC_LOGW("FlushBuffer failed");
+        GRAPHIC_LOGW("FlushBuffer SendRequest failed");
         return ret;
     }
     ReadInt32(&reply, &ret);
-    FreeBuffer(reinterpret_cast<void *>(ptr));
-    if (ret != SURFACE_ERROR_OK) {
-        GRAPHIC_LOGW("FlushBuffer failed code=%d", ret);
-        return -1;
+    uint32_t generation = 0;
+    ReadGenerations(reply, generation);
+    if (ret == SURFACE_ERROR_OK) {
+        /* returned before the next buffer is read, which may be the same one released by consumer meanwhile. */
+        ReturnProxyBuffer(&buffer, true, generation);
     }
-    manager->UnmapBuffer(*buffer);
-    delete buffer;
+    if ((ret == SURFACE_ERROR_OK) && (next != nullptr)) {
+        /* the result of request follows the result of flush, and the buffer if request succeeds. */
+        int32_t requestRet = -1;
+        ReadInt32(&reply, &requestRet);
+        if (requestRet == SURFACE_ERROR_OK) {
+            *next = ReadRequestedBuffer(reply, generation);
+        }
+    }
+    FreeBuffer(reinterpret_cast<void *>(ptr));
     return ret;
 }
 
-void BufferClientProducer::Cancel(SurfaceBufferImpl* buffer)
+void BufferClientProducer::WriteBufferRef(IpcIo& io, SurfaceBufferImpl& buffer)
 {
-    if (buffer == nullptr) {
-        return;
+    WriteUint32(&io, buffer.GetSlot());
+    WriteInt32(&io, buffer.GetKey());
+    if (buffer.GetSlot() == BUFFER_SLOT_INVALID) {
+        buffer.WriteAttrToIpcIo(io);
     }
+}
+
+int32_t BufferClientProducer::SendCancel(SurfaceBufferImpl& buffer, uint32_t& generation)
+{
     IpcIo requestIo;
-    uint8_t requestIoData[DEFAULT_IPC_SIZE];
-    IpcIoInit(&requestIo, requestIoData, DEFAULT_IPC_SIZE, 0);
-    buffer->WriteToIpcIo(requestIo);
+    uint8_t requestIoData[BUFFER_IPC_SIZE];
+    IpcIoInit(&requestIo, requestIoData, BUFFER_IPC_SIZE, 0);
+    WriteBufferRef(requestIo, buffer);
     IpcIo reply;
     uintptr_t ptr;
     MessageOption option;
@@ -125,56 +470,70 @@ void BufferClientProducer::Cancel(SurfaceBufferImpl* buffer)
     int32_t ret = SendRequest(sid_, CANCEL_BUFFER, &requestIo, &reply, option, &ptr);
     if (ret != SURFACE_ERROR_OK) {
         GRAPHIC_LOGW("Cancel buffer failed");
-    } else {
-        FreeBuffer(reinterpret_cast<void *>(ptr));
+        return ret;
     }
-    BufferManager* manager = BufferManager::GetInstance();
-    RETURN_IF_FAIL(manager);
-    manager->UnmapBuffer(*buffer);
-    delete buffer;
+    ReadInt32(&reply, &ret);
+    ReadGenerations(reply, generation);
+    FreeBuffer(reinterpret_cast<void *>(ptr));
+    return ret;
 }
 
-void BufferClientProducer::SetQueueSize(uint8_t queueSize)
+int32_t BufferClientProducer::SendOneWay(uint32_t code, SurfaceBufferImpl& buffer, uint32_t& generation)
 {
     IpcIo requestIo;
-    uint8_t requestIoData[DEFAULT_IPC_SIZE];
-    IpcIoInit(&requestIo, requestIoData, DEFAULT_IPC_SIZE, 0);
-    WriteUint8(&requestIo, queueSize);
-    IpcIo reply;
-    uintptr_t ptr;
+    uint8_t requestIoData[BUFFER_IPC_SIZE];
+    IpcIoInit(&requestIo, requestIoData, BUFFER_IPC_SIZE, 0);
+    WriteBufferRef(requestIo, buffer);
+    if (code == FLUSH_BUFFER && !buffer.WriteExtraDataToIpcIo(requestIo)) {
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
     MessageOption option;
     MessageOptionInit(&option);
-    int32_t ret = SendRequest(sid_, SET_QUEUE_SIZE, &requestIo, &reply, option, &ptr);
+    option.flags = TF_OP_ASYNC;
+    int32_t ret = SendRequest(sid_, code, &requestIo, nullptr, option, nullptr);
     if (ret != SURFACE_ERROR_OK) {
-        GRAPHIC_LOGW("Set Attr(%d:%u) failed", SET_QUEUE_SIZE, queueSize);
+        GRAPHIC_LOGW("One-way request(%u) failed", code);
+        return ret;
     }
-    FreeBuffer(reinterpret_cast<void *>(ptr));
+    /* no reply, the generation of last reply is assumed, stale mappings are dropped by next reply. */
+    pthread_mutex_lock(&lock_);
+    generation = generation_;
+    pthread_mutex_unlock(&lock_);
+    return ret;
 }
 
-uint8_t BufferClientProducer::GetQueueSize()
+void BufferClientProducer::Cancel(SurfaceBufferImpl* buffer)
+{
+    if (buffer == nullptr) {
+        return;
+    }
+    uint32_t generation = 0;
+    int32_t ret = IsAsync() ? SendOneWay(CANCEL_BUFFER, *buffer, generation) : SendCancel(*buffer, generation);
+    ReturnProxyBuffer(buffer, ret == SURFACE_ERROR_OK, generation);
+}
+
+void BufferClientProducer::SetQueueSize(uint8_t queueSize)
 {
     IpcIo requestIo;
     uint8_t requestIoData[DEFAULT_IPC_SIZE];
     IpcIoInit(&requestIo, requestIoData, DEFAULT_IPC_SIZE, 0);
+    WriteUint8(&requestIo, queueSize);
     IpcIo reply;
     uintptr_t ptr;
     MessageOption option;
     MessageOptionInit(&option);
-    int32_t ret = SendRequest(sid_, GET_QUEUE_SIZE, &requestIo, &reply, option, &ptr);
-    if (ret != SURFACE_ERROR_OK) {
-        GRAPHIC_LOGW("GetAttr SendRequest failed, errno=%d", ret);
-        return 0;
-    }
-    ReadInt32(&reply, &ret);
+    int32_t ret = SendRequest(sid_, SET_QUEUE_SIZE, &requestIo, &reply, option, &ptr);
     if (ret != SURFACE_ERROR_OK) {
-        GRAPHIC_LOGW("GetAttr failed code=%d", GET_QUEUE_SIZE);
-        FreeBuffer(reinterpret_cast<void *>(ptr));
-        return 0;
+        GRAPHIC_LOGW("Set Attr(%d:%u) failed", SET_QUEUE_SIZE, queueSize);
     }
-    uint8_t queueSize;
-    ReadUint8(&reply, &queueSize);
     FreeBuffer(reinterpret_cast<void *>(ptr));
-    return queueSize;
+    InvalidateConfig();
+}
+
+uint8_t BufferClientProducer::GetQueueSize()
+{
+    BufferQueueConfig config;
+    return GetConfig(config) ? static_cast<uint8_t>(config.queueSize) : 0;
 }
 
 void BufferClientProducer::SetWidthAndHeight(uint32_t width, uint32_t height)
@@ -194,17 +553,20 @@ void BufferClientProducer::SetWidthAndHeight(uint32_t width, uint32_t height)
     } else {
         FreeBuffer(reinterpret_cast<void *>(ptr));
     }
+    InvalidateConfig();
     return;
 }
 
 uint32_t BufferClientProducer::GetWidth()
 {
-    return GetAttr(GET_WIDTH);
+    BufferQueueConfig config;
+    return GetConfig(config) ? config.width : 0;
 }
 
 uint32_t BufferClientProducer::GetHeight()
 {
-    return GetAttr(GET_HEIGHT);
+    BufferQueueConfig config;
+    return GetConfig(config) ? config.height : 0;
 }
 
 void BufferClientProducer::SetFormat(uint32_t format)
@@ -214,7 +576,8 @@ void BufferClientProducer::SetFormat(uint32_t format)
 
 uint32_t BufferClientProducer::GetFormat()
 {
-    return GetAttr(GET_FORMAT);
+    BufferQueueConfig config;
+    return GetConfig(config) ? config.format : 0;
 }
 
 void BufferClientProducer::SetStrideAlignment(uint32_t strideAlignment)
@@ -224,12 +587,14 @@ void BufferClientProducer::SetStrideAlignment(uint32_t strideAlignment)
 
 uint32_t BufferClientProducer::GetStrideAlignment()
 {
-    return GetAttr(GET_STRIDE_ALIGNMENT);
+    BufferQueueConfig config;
+    return GetConfig(config) ? config.strideAlignment : 0;
 }
 
 uint32_t BufferClientProducer::GetStride()
 {
-    return GetAttr(GET_STRIDE);
+    BufferQueueConfig config;
+    return GetConfig(config) ? config.stride : 0;
 }
 
 void BufferClientProducer::SetSize(uint32_t size)
@@ -239,7 +604,8 @@ void BufferClientProducer::SetSize(uint32_t size)
 
 uint32_t BufferClientProducer::GetSize()
 {
-    return GetAttr(GET_SIZE);
+    BufferQueueConfig config;
+    return GetConfig(config) ? config.size : 0;
 }
 
 void BufferClientProducer::SetUsage(uint32_t usage)
@@ -249,8 +615,8 @@ void BufferClientProducer::SetUsage(uint32_t usage)
 
 uint32_t BufferClientProducer::GetUsage()
 {
-    uint32_t usage = GetAttr(GET_USAGE);
-    return usage;
+    BufferQueueConfig config;
+    return GetConfig(config) ? config.usage : 0;
 }
 
 void BufferClientProducer::SetUserData(const std::string& key, const std::string& value)
@@ -315,31 +681,6 @@ void BufferClientProducer::SetAttr(uint32_t code, uint32_t value)
     } else {
         FreeBuffer(reinterpret_cast<void *>(ptr));
     }
-}
-
-uint32_t BufferClientProducer::GetAttr(uint32_t code)
-{
-    IpcIo requestIo;
-    uint8_t requestIoData[DEFAULT_IPC_SIZE];
-    IpcIoInit(&requestIo, requestIoData, DEFAULT_IPC_SIZE, 0);
-    IpcIo reply;
-    uintptr_t ptr;
-    MessageOption option;
-    MessageOptionInit(&option);
-    int32_t ret = SendRequest(sid_, code, &requestIo, &reply, option, &ptr);
-    if (ret != SURFACE_ERROR_OK) {
-        GRAPHIC_LOGW("GetAttr SendRequest failed, errno=%d", ret);
-        return 0;
-    }
-    ReadInt32(&reply, &ret);
-    if (ret != SURFACE_ERROR_OK) {
-        GRAPHIC_LOGW("GetAttr failed code=%d", code);
-        FreeBuffer(reinterpret_cast<void *>(ptr));
-        return 0;
-    }
-    uint32_t attr;
-    ReadUint32(&reply, &attr);
-    FreeBuffer(reinterpret_cast<void *>(ptr));
-    return attr;
+    InvalidateConfig();
 }
 } // end namespace
@@ -16,9 +16,11 @@
 #ifndef GRAPHIC_LITE_BUFFER_CLIENT_PRODUCER_H
 #define GRAPHIC_LITE_BUFFER_CLIENT_PRODUCER_H
 
+#include <list>
 #include <pthread.h>
 #include "buffer_producer.h"
 #include "buffer_queue.h"
+#include "ibuffer_producer_listener.h"
 #include "ipc_skeleton.h"
 #include "serializer.h"
 #include "surface_buffer.h"
@@ -26,6 +28,9 @@ namespace OHOS {
 /**
  * @brief Surface producer client class in multi process. Surface Client invoke these method to send ipc
  *        request to BufferQueueProducer for request buffer, flush buffer, cancel buffer and set buffer attr.
+ *        Mapped buffers are kept after flush or cancel and reused by later requests, until the buffer
+ *        generation of BufferQueue changes, that is buffers are reallocated or freed. Once mapped, buffers
+ *        are referred by slot in ipc messages instead of the whole buffer handle.
  */
 class BufferClientProducer : public BufferProducer {
 public:
@@ -61,6 +66,17 @@ public:
      */
     int32_t FlushBuffer(SurfaceBufferImpl* buffer) override;
 
+    /**
+     * @brief Flush buffer and request next buffer at once. Client producer sends one request(code=FLUSH_AND_REQUEST)
+     *        instead of FLUSH_BUFFER and REQUEST_BUFFER, the next buffer is requested only if flush succeeds.
+     * @param [in] SurfaceBufferImpl pointer, Which buffer could acquire for consumer.
+     * @param [out] next, the requested buffer, nullptr if flush failed or no buffer could be requested.
+     * @param [in] whether waiting or not for next buffer.
+     * @returns Flush buffer succeed or not.
+     *        0 is succeed; other is failed.
+     */
+    int32_t FlushAndRequestBuffer(SurfaceBufferImpl* buffer, SurfaceBufferImpl*& next, uint8_t wait) override;
+
     /**
      * @brief Cancel buffer. Client Producer sends request(CANCEL_BUFFER) to cancel this buffer.
      *        BufferQueueProducer push push buffer to free list for request it again.
@@ -75,7 +91,7 @@ public:
     void SetQueueSize(uint8_t queueSize) override;
 
     /**
-     * @brief Get queue size. Client Producer sends request(GET_QUEUE_SIZE) to get max buffer count.
+     * @brief Get queue size from the config snapshot, see GetConfig.
      * @returns queue size.
      */
     uint8_t GetQueueSize() override;
@@ -88,13 +104,13 @@ public:
     void SetWidthAndHeight(uint32_t width, uint32_t height) override;
 
     /**
-     * @brief Client Producer sends request(GET_WIDTH) to get width, buffer width to calculate the buffer size..
+     * @brief Get width from the config snapshot, see GetConfig.
      * @returns width, Buffer width.
      */
     uint32_t GetWidth() override;
 
     /**
-     * @brief Client Producer sends request(GET_HEIGHT) to get height, buffer height to calculate the buffer size..
+     * @brief Get height from the config snapshot, see GetConfig.
      * @returns height, Buffer height.
      */
     uint32_t GetHeight() override;
@@ -107,7 +123,7 @@ public:
     void SetFormat(uint32_t format) override;
 
     /**
-     * @brief Client Producer sends request(GET_FORMAT) to get format, buffer format to calculate the buffer size..
+     * @brief Get format from the config snapshot, see GetConfig.
      * @returns format, Buffer format.
      */
     uint32_t GetFormat() override;
@@ -120,14 +136,14 @@ public:
     void SetStrideAlignment(uint32_t strideAlignment) override;
 
     /**
-     * @brief Client Producer sends request(GET_STRIDE_ALIGNMENT) to get stride alignment bytes.
+     * @brief Get stride alignment bytes from the config snapshot, see GetConfig.
      *        Default alignment is 4 bytes.
      * @returns strideAlignment, Buffer stride alignment.
      */
     uint32_t GetStrideAlignment() override;
 
     /**
-     * @brief Client Producer sends request(GET_STRIDE) to get bytes of one stride which calculate by width,
+     * @brief Get bytes of one stride from the config snapshot, see GetConfig. It is calculated by width,
      *        format and stride alignment.
      * @returns The stride
      */
@@ -141,7 +157,7 @@ public:
     void SetSize(uint32_t size) override;
 
     /**
-     * @brief Client Producer sends request(GET_SIZE) to get buffer size. Surface alloc buffer size.
+     * @brief Get buffer size from the config snapshot, see GetConfig.
      *        The size is setted by SetSize() or calculated by width, height, format...
      * @returns The buffer size.
      */
@@ -156,7 +172,7 @@ public:
     void SetUsage(uint32_t usage) override;
 
     /**
-     * @brief Client Producer sends request(GET_USAGE) to get buffer usage. Surface alloc physical or
+     * @brief Get buffer usage from the config snapshot, see GetConfig. Surface alloc physical or
      *        virtual memory buffer. All usage sees detail in OHOS::BUFFER_CONSUMER_USAGE.
      * @returns The buffer usage.
      */
@@ -175,11 +191,66 @@ public:
      */
     std::string GetUserData(const std::string& key) override;
 
+    /**
+     * @brief Set async mode. In async mode, FLUSH_BUFFER and CANCEL_BUFFER are sent one-way, with all extra data
+     *        since no baseline could be confirmed. Errors are reported with next reply by the producer listener.
+     * @param [in] async, enable async mode or not.
+     */
+    void SetAsyncMode(bool async);
+
+    /**
+     * @brief Register producer listener, which is notified of errors of one-way requests.
+     * @param [in] IBufferProducerListener, the producer listener.
+     */
+    void RegisterProducerListener(IBufferProducerListener& listener);
+
+    /**
+     * @brief Unregister producer listener.
+     */
+    void UnregisterProducerListener();
+
 private:
-    uint32_t GetAttr(uint32_t code);
+    struct ProxyBuffer {
+        SurfaceBufferImpl* buffer;
+        uint32_t generation;
+        bool held;
+    };
     void SetAttr(uint32_t code, uint32_t value);
+    int32_t SendCancel(SurfaceBufferImpl& buffer, uint32_t& generation);
+    int32_t SendOneWay(uint32_t code, SurfaceBufferImpl& buffer, uint32_t& generation);
+    bool IsAsync();
+    void ReportAsyncError(int32_t error);
+    int32_t Flush(SurfaceBufferImpl* buffer, SurfaceBufferImpl** next, uint8_t wait);
+    int32_t SendFlush(SurfaceBufferImpl& buffer, SurfaceBufferImpl** next, uint8_t wait);
+    /*
+     * Buffers mapped already are referred by slot in both directions, instead of the whole buffer handle.
+     * The slots mapped in current generation are sent with each request for buffer.
+     */
+    void WriteKnownSlots(IpcIo& io);
+    void WriteBufferRef(IpcIo& io, SurfaceBufferImpl& buffer);
+    SurfaceBufferImpl* ReadRequestedBuffer(IpcIo& reply, uint32_t generation);
+    SurfaceBufferImpl* GetSlotProxyBuffer(uint32_t slot, int32_t key, uint32_t generation);
+    void ReadGenerations(IpcIo& reply, uint32_t& generation);
+    /*
+     * Get all attributes. They are requested once by GET_CONFIG and kept until the config generation carried by
+     * buffer replies changes, or attributes are set by this producer.
+     */
+    bool GetConfig(BufferQueueConfig& config);
+    void InvalidateConfig();
+    SurfaceBufferImpl* GetProxyBuffer(SurfaceBufferImpl& buffer, uint32_t generation);
+    void ReturnProxyBuffer(SurfaceBufferImpl* buffer, bool valid, uint32_t generation);
+    void ReleaseProxyBuffer(SurfaceBufferImpl* buffer);
     SvcIdentity sid_;
     IpcObjectStub objectStub_;
+    std::list<ProxyBuffer> proxyBuffers_;
+    uint32_t generation_;
+    pthread_mutex_t lock_;
+    BlobPool* blobPool_; /* recycles blob extra data of the proxy buffers */
+    BufferQueueConfig config_; /* snapshot of queue attributes, kept until the config generation changes */
+    bool configValid_;
+    uint32_t configEpoch_; /* increased when attributes are set by this producer */
+    bool async_;
+    IBufferProducerListener* producerListener_;
 };
 } // end namespace
 
@@ -15,11 +15,62 @@
 
 #include "buffer_manager.h"
 
+#include <algorithm>
+
 #include "buffer_common.h"
+#include "buffer_queue.h"
+#include "buffer_worker.h"
 #include "securec.h"
 #include "surface_buffer.h"
 
 namespace OHOS {
+const uint32_t BUFFER_CACHE_DEFAULT_BUDGET = 4 * 1024 * 1024; // 4MB
+const uint32_t CACHE_LINE_SIZE = 64;
+/* 64-bit words holding a buffer handle with the max reserved values of a surface buffer */
+const uint32_t RANGE_HANDLE_WORDS =
+    (sizeof(BufferHandle) + BUFFER_RESERVE_MAX_NUM * sizeof(int32_t) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+const uint32_t SIMD_ALIGNMENT = 64;
+
+BufferManager::BufferManager()
+    : gralloc_(nullptr), allocator_(nullptr), cacheBudget_(BUFFER_CACHE_DEFAULT_BUDGET), memoryBudget_(0), usedBytes_(0)
+{
+    cacheStats_ = {0};
+    for (uint32_t i = 0; i < BUFFER_CONSUMER_USAGE_MAX; i++) {
+        usageAllocators_[i] = nullptr;
+    }
+    pthread_mutex_init(&initLock_, nullptr);
+    pthread_mutex_init(&cacheLock_, nullptr);
+    pthread_mutex_init(&reclaimLock_, nullptr);
+    pthread_mutex_init(&queuesLock_, nullptr);
+    for (uint32_t i = 0; i < REGISTRY_SHARD_NUM; i++) {
+        pthread_mutex_init(&registry_[i].lock, nullptr);
+    }
+}
+
+BufferManager::~BufferManager()
+{
+    if (gralloc_ != nullptr) {
+        FlushDeferredFree();
+        TrimCache();
+    }
+    for (uint32_t i = 0; i < REGISTRY_SHARD_NUM; i++) {
+        pthread_mutex_destroy(&registry_[i].lock);
+    }
+    pthread_mutex_destroy(&queuesLock_);
+    pthread_mutex_destroy(&reclaimLock_);
+    pthread_mutex_destroy(&cacheLock_);
+    pthread_mutex_destroy(&initLock_);
+}
+
+BufferManager::RegistryShard& BufferManager::GetShard(const BufferKey& key)
+{
+    uint64_t hash = (static_cast<uint64_t>(static_cast<uint32_t>(key.key)) << 32) ^ key.phyAddr;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL; // 64-bit finalizer of murmur hash
+    hash ^= hash >> 33;
+    return registry_[hash % REGISTRY_SHARD_NUM];
+}
+
 BufferManager* BufferManager::GetInstance()
 {
     static BufferManager instance;
@@ -28,16 +79,60 @@ BufferManager* BufferManager::GetInstance()
 
 bool BufferManager::Init()
 {
-    if (grallocFucs_ != nullptr) {
+    pthread_mutex_lock(&initLock_);
+    if (gralloc_ != nullptr) {
+        pthread_mutex_unlock(&initLock_);
         GRAPHIC_LOGI("BufferManager has init succeed.");
         return true;
     }
-    if (GrallocInitialize(&grallocFucs_) != DISPLAY_SUCCESS) {
+    gralloc_ = BufferAllocator::GetBuiltin(BUFFER_ALLOCATOR_GRALLOC);
+    if (gralloc_ == nullptr) {
+        pthread_mutex_unlock(&initLock_);
         return false;
     }
+    if (allocator_ == nullptr) {
+        allocator_ = gralloc_;
+    }
+    pthread_mutex_unlock(&initLock_);
     return true;
 }
 
+void BufferManager::SetAllocator(BufferAllocator* allocator)
+{
+    pthread_mutex_lock(&initLock_);
+    allocator_ = (allocator != nullptr) ? allocator : gralloc_;
+    pthread_mutex_unlock(&initLock_);
+}
+
+int32_t BufferManager::SetAllocator(uint32_t usage, BufferAllocator* allocator)
+{
+    if (usage >= BUFFER_CONSUMER_USAGE_MAX) {
+        GRAPHIC_LOGW("Set allocator of invalid usage %u.", usage);
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    pthread_mutex_lock(&initLock_);
+    usageAllocators_[usage] = allocator;
+    pthread_mutex_unlock(&initLock_);
+    return SURFACE_ERROR_OK;
+}
+
+BufferAllocator* BufferManager::SelectAllocator(uint32_t usage, uint32_t flags)
+{
+    if (((flags & BUFFER_ALLOC_FLAG_HUGE_PAGE) != 0) && (usage == BUFFER_CONSUMER_USAGE_SORTWARE)) {
+        BufferAllocator* hugePage = BufferAllocator::GetBuiltin(BUFFER_ALLOCATOR_HUGE_PAGE);
+        if (hugePage != nullptr) {
+            return hugePage;
+        }
+    }
+    pthread_mutex_lock(&initLock_);
+    BufferAllocator* allocator = allocator_;
+    if ((usage < BUFFER_CONSUMER_USAGE_MAX) && (usageAllocators_[usage] != nullptr)) {
+        allocator = usageAllocators_[usage];
+    }
+    pthread_mutex_unlock(&initLock_);
+    return allocator;
+}
+
 bool BufferManager::ConvertUsage(uint64_t& destUsage, uint32_t srcUsage) const
 {
     switch (srcUsage) {
@@ -95,9 +190,44 @@ bool BufferManager::ConvertFormat(PixelFormat& destFormat, uint32_t srcFormat) c
     return true;
 }
 
+void BufferManager::InitPlanes(SurfaceBufferImpl& buffer, uint32_t format, uint32_t height) const
+{
+    PlaneInfo planes[SURFACE_MAX_PLANE_NUM] = {{0}};
+    uint8_t count = IMAGE_PIXEL_FORMAT_PLANE_COUNT_RGB;
+    uint32_t stride = static_cast<uint32_t>(buffer.GetStride());
+    uint64_t lumaSize = static_cast<uint64_t>(stride) * height;
+    uint64_t chromaHeight = (height + 1) / 2; // 4:2:0 chroma planes have half rows of luma plane, rounded up
+    switch (format) {
+        case IMAGE_PIXEL_FORMAT_NV12:
+        case IMAGE_PIXEL_FORMAT_NV21:
+            count = IMAGE_PIXEL_FORMAT_PLANE_COUNT_YUVSPXX;
+            planes[1] = {stride, static_cast<uint32_t>(lumaSize), static_cast<uint32_t>(stride * chromaHeight)};
+            break;
+        case IMAGE_PIXEL_FORMAT_YUV420:
+        case IMAGE_PIXEL_FORMAT_YVU420: {
+            count = IMAGE_PIXEL_FORMAT_PLANE_COUNT_YUV4XX;
+            uint32_t chromaStride = (stride + 1) / 2; // chroma planes have half columns of luma plane, rounded up
+            uint32_t chromaSize = static_cast<uint32_t>(chromaStride * chromaHeight);
+            planes[1] = {chromaStride, static_cast<uint32_t>(lumaSize), chromaSize};
+            planes[2] = {chromaStride, static_cast<uint32_t>(lumaSize + chromaSize), chromaSize};
+            break;
+        }
+        default:
+            break;
+    }
+    planes[0] = {stride, 0, static_cast<uint32_t>(lumaSize)};
+    const PlaneInfo& last = planes[count - 1];
+    if ((stride == 0) || (static_cast<uint64_t>(last.offset) + last.size > buffer.GetMaxSize())) {
+        /* allocated by size, or the backend uses an unknown layout, describe the buffer as one plane. */
+        count = IMAGE_PIXEL_FORMAT_PLANE_COUNT_RGB;
+        planes[0] = {stride, 0, buffer.GetMaxSize()};
+    }
+    buffer.SetPlanes(planes, count);
+}
+
 BufferHandle* BufferManager::AllocateBufferHandle(SurfaceBufferImpl& buffer) const
 {
-    uint32_t total = buffer.GetReserveFds() + buffer.GetReserveInts() + sizeof(BufferHandle);
+    uint32_t total = (buffer.GetReserveFds() + buffer.GetReserveInts()) * sizeof(int32_t) + sizeof(BufferHandle);
     BufferHandle* bufferHandle = static_cast<BufferHandle *>(malloc(total));
     if (bufferHandle != nullptr) {
         bufferHandle->key = buffer.GetKey();
@@ -109,22 +239,253 @@ BufferHandle* BufferManager::AllocateBufferHandle(SurfaceBufferImpl& buffer) con
             return nullptr;
         }
         bufferHandle->virAddr = buffer.GetVirAddr();
+        bufferHandle->stride = buffer.GetStride();
         bufferHandle->reserveFds = buffer.GetReserveFds();
         bufferHandle->reserveInts = buffer.GetReserveInts();
+        const int32_t* reserve = buffer.GetReserve();
         for (uint32_t i = 0; i < (buffer.GetReserveFds() + buffer.GetReserveInts()); i++) {
-            buffer.GetInt32(i, bufferHandle->reserve[i]);
+            bufferHandle->reserve[i] = reserve[i];
         }
         return bufferHandle;
     }
     return nullptr;
 }
 
-SurfaceBufferImpl* BufferManager::AllocBuffer(AllocInfo info)
+static bool IsSameAllocInfo(const AllocInfo& left, const AllocInfo& right)
+{
+    return (left.width == right.width) && (left.height == right.height) && (left.usage == right.usage) &&
+        (left.format == right.format) && (left.expectedSize == right.expectedSize);
+}
+
+BufferHandle* BufferManager::GetCachedHandle(const AllocInfo& info, BufferAllocator* allocator)
 {
-    RETURN_VAL_IF_FAIL((grallocFucs_ != nullptr), nullptr);
     BufferHandle* bufferHandle = nullptr;
-    if ((grallocFucs_->AllocMem == nullptr) || (grallocFucs_->AllocMem(&info, &bufferHandle) != DISPLAY_SUCCESS)) {
+    pthread_mutex_lock(&cacheLock_);
+    std::list<BufferEntry>::iterator iter;
+    for (iter = cacheList_.begin(); iter != cacheList_.end(); ++iter) {
+        if ((iter->allocator == allocator) && IsSameAllocInfo(iter->info, info)) {
+            bufferHandle = iter->handle;
+            cacheStats_.cachedBytes -= allocator->GetFootprint(bufferHandle);
+            cacheList_.erase(iter);
+            break;
+        }
+    }
+    if (bufferHandle != nullptr) {
+        cacheStats_.hits++;
+    } else {
+        cacheStats_.misses++;
+    }
+    pthread_mutex_unlock(&cacheLock_);
+    return bufferHandle;
+}
+
+bool BufferManager::PutCachedHandle(const BufferEntry& entry)
+{
+    std::list<BufferEntry> evicted;
+    pthread_mutex_lock(&cacheLock_);
+    uint32_t size = entry.allocator->GetFootprint(entry.handle);
+    if (size > cacheBudget_) {
+        pthread_mutex_unlock(&cacheLock_);
+        return false;
+    }
+    while (cacheStats_.cachedBytes + size > cacheBudget_ && !cacheList_.empty()) {
+        cacheStats_.cachedBytes -= cacheList_.back().allocator->GetFootprint(cacheList_.back().handle);
+        cacheStats_.evictions++;
+        evicted.push_back(cacheList_.back());
+        cacheList_.pop_back();
+    }
+    cacheList_.push_front(entry);
+    cacheStats_.cachedBytes += size;
+    pthread_mutex_unlock(&cacheLock_);
+    FreeHandles(evicted);
+    return true;
+}
+
+void BufferManager::FreeHandles(std::list<BufferEntry>& entries)
+{
+    std::list<BufferEntry>::iterator iter;
+    for (iter = entries.begin(); iter != entries.end(); ++iter) {
+        iter->allocator->FreeMem(iter->handle);
+    }
+    entries.clear();
+}
+
+void BufferManager::SetCacheBudget(uint32_t budget)
+{
+    std::list<BufferEntry> evicted;
+    pthread_mutex_lock(&cacheLock_);
+    cacheBudget_ = budget;
+    while (cacheStats_.cachedBytes > cacheBudget_ && !cacheList_.empty()) {
+        cacheStats_.cachedBytes -= cacheList_.back().allocator->GetFootprint(cacheList_.back().handle);
+        cacheStats_.evictions++;
+        evicted.push_back(cacheList_.back());
+        cacheList_.pop_back();
+    }
+    pthread_mutex_unlock(&cacheLock_);
+    FreeHandles(evicted);
+}
+
+BufferCacheStats BufferManager::GetCacheStats()
+{
+    pthread_mutex_lock(&cacheLock_);
+    BufferCacheStats stats = cacheStats_;
+    pthread_mutex_unlock(&cacheLock_);
+    return stats;
+}
+
+void BufferManager::TrimCache()
+{
+    std::list<BufferEntry> evicted;
+    pthread_mutex_lock(&cacheLock_);
+    evicted.swap(cacheList_);
+    cacheStats_.cachedBytes = 0;
+    pthread_mutex_unlock(&cacheLock_);
+    FreeHandles(evicted);
+}
+
+void BufferManager::SetMemoryBudget(uint64_t budget)
+{
+    pthread_mutex_lock(&cacheLock_);
+    memoryBudget_ = budget;
+    pthread_mutex_unlock(&cacheLock_);
+}
+
+uint64_t BufferManager::GetMemoryUsage()
+{
+    pthread_mutex_lock(&cacheLock_);
+    uint64_t usage = usedBytes_ + cacheStats_.cachedBytes;
+    pthread_mutex_unlock(&cacheLock_);
+    return usage;
+}
+
+void BufferManager::RegisterQueue(BufferQueue* queue)
+{
+    RETURN_IF_FAIL(queue);
+    pthread_mutex_lock(&queuesLock_);
+    queues_.push_back(queue);
+    pthread_mutex_unlock(&queuesLock_);
+}
+
+void BufferManager::UnregisterQueue(BufferQueue* queue)
+{
+    pthread_mutex_lock(&queuesLock_);
+    queues_.remove(queue);
+    pthread_mutex_unlock(&queuesLock_);
+}
+
+void BufferManager::CollectIdleBuffers(std::list<IdleBuffer>& idleBuffers)
+{
+    pthread_mutex_lock(&queuesLock_);
+    std::list<BufferQueue*>::iterator iter;
+    for (iter = queues_.begin(); iter != queues_.end(); ++iter) {
+        std::list<std::pair<int64_t, SurfaceBufferImpl*>> buffers;
+        (*iter)->GetFreeBuffers(buffers);
+        std::list<std::pair<int64_t, SurfaceBufferImpl*>>::iterator bufferIter;
+        for (bufferIter = buffers.begin(); bufferIter != buffers.end(); ++bufferIter) {
+            IdleBuffer idleBuffer = {bufferIter->first, *iter, bufferIter->second};
+            idleBuffers.push_back(idleBuffer);
+        }
+    }
+    pthread_mutex_unlock(&queuesLock_);
+    idleBuffers.sort();
+}
+
+bool BufferManager::TrimIdleBuffer(std::list<IdleBuffer>& idleBuffers)
+{
+    /* Buffers requested or queues unregistered since the collection are skipped. */
+    while (!idleBuffers.empty()) {
+        IdleBuffer idleBuffer = idleBuffers.front();
+        idleBuffers.pop_front();
+        pthread_mutex_lock(&queuesLock_);
+        bool trimmed = (std::find(queues_.begin(), queues_.end(), idleBuffer.queue) != queues_.end()) &&
+            idleBuffer.queue->TrimFree(idleBuffer.buffer);
+        pthread_mutex_unlock(&queuesLock_);
+        if (trimmed) {
+            ReleaseBuffer(&idleBuffer.buffer, false);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BufferManager::ReserveMemory(uint32_t size)
+{
+    /* Idle buffers of all queues are collected once at the first trim, and trimmed in order. */
+    std::list<IdleBuffer> idleBuffers;
+    bool collected = false;
+    while (true) {
+        std::list<BufferEntry> evicted;
+        pthread_mutex_lock(&cacheLock_);
+        if (memoryBudget_ == 0 || usedBytes_ + cacheStats_.cachedBytes + size <= memoryBudget_) {
+            usedBytes_ += size;
+            pthread_mutex_unlock(&cacheLock_);
+            return true;
+        }
+        if (!cacheList_.empty()) {
+            cacheStats_.cachedBytes -= cacheList_.back().allocator->GetFootprint(cacheList_.back().handle);
+            cacheStats_.evictions++;
+            evicted.push_back(cacheList_.back());
+            cacheList_.pop_back();
+        }
+        pthread_mutex_unlock(&cacheLock_);
+        if (!evicted.empty()) {
+            FreeHandles(evicted);
+            continue;
+        }
+        if (!collected) {
+            CollectIdleBuffers(idleBuffers);
+            collected = true;
+        }
+        if (!TrimIdleBuffer(idleBuffers)) {
+            GRAPHIC_LOGE("Alloc %u bytes exceeds memory budget.", size);
+            return false;
+        }
+    }
+}
+
+void BufferManager::UnreserveMemory(uint32_t size)
+{
+    pthread_mutex_lock(&cacheLock_);
+    usedBytes_ -= size;
+    pthread_mutex_unlock(&cacheLock_);
+}
+
+BufferHandle* BufferManager::AllocHandle(const AllocInfo& info, BufferAllocator* allocator)
+{
+    BufferHandle* bufferHandle = GetCachedHandle(info, allocator);
+    if (bufferHandle != nullptr) {
+        pthread_mutex_lock(&cacheLock_);
+        usedBytes_ += allocator->GetFootprint(bufferHandle);
+        pthread_mutex_unlock(&cacheLock_);
+        return bufferHandle;
+    }
+    /* Reserve before the allocation, so that the budget is met before the memory is taken. */
+    uint32_t reserved = allocator->EstimateFootprint(info);
+    if (!ReserveMemory(reserved)) {
+        return nullptr;
+    }
+    if (allocator->AllocMem(info, &bufferHandle) != DISPLAY_SUCCESS) {
         GRAPHIC_LOGE("Alloc graphic buffer failed");
+        UnreserveMemory(reserved);
+        return nullptr;
+    }
+    /* The estimate misses the padding of the backend, which is reserved now. */
+    uint32_t footprint = allocator->GetFootprint(bufferHandle);
+    if (footprint < reserved) {
+        UnreserveMemory(reserved - footprint);
+    } else if (footprint > reserved && !ReserveMemory(footprint - reserved)) {
+        UnreserveMemory(reserved);
+        allocator->FreeMem(bufferHandle);
+        return nullptr;
+    }
+    return bufferHandle;
+}
+
+SurfaceBufferImpl* BufferManager::AllocBuffer(AllocInfo info, BufferAllocator* allocator)
+{
+    RETURN_VAL_IF_FAIL((allocator != nullptr), nullptr);
+    BufferHandle* bufferHandle = AllocHandle(info, allocator);
+    if (bufferHandle == nullptr) {
         return nullptr;
     }
     SurfaceBufferImpl* buffer = new SurfaceBufferImpl();
@@ -134,24 +495,28 @@ SurfaceBufferImpl* BufferManager::AllocBuffer(AllocInfo info)
         buffer->SetKey(bufferHandle->key);
         buffer->SetPhyAddr(bufferHandle->phyAddr);
         buffer->SetStride(bufferHandle->stride);
-        buffer->SetReserveFds(bufferHandle->reserveFds);
-        buffer->SetReserveInts(bufferHandle->reserveInts);
-        for (uint32_t i = 0; i < (bufferHandle->reserveFds + bufferHandle->reserveInts); i++) {
-            buffer->SetInt32(i, bufferHandle->reserve[i]);
+        if (buffer->SetReserve(bufferHandle->reserve, bufferHandle->reserveFds, bufferHandle->reserveInts) !=
+            SURFACE_ERROR_OK) {
+            GRAPHIC_LOGW("Reserved values of buffer handle are not carried.");
         }
         BufferKey key = {bufferHandle->key, bufferHandle->phyAddr};
-        bufferHandleMap_.insert(std::make_pair(key, bufferHandle));
+        BufferEntry entry = {bufferHandle, allocator, info, false, 0};
+        RegistryShard& shard = GetShard(key);
+        pthread_mutex_lock(&shard.lock);
+        shard.bufferHandleMap.insert(std::make_pair(key, entry));
+        pthread_mutex_unlock(&shard.lock);
         GRAPHIC_LOGD("Alloc buffer succeed to shared memory segment.");
     } else {
-        grallocFucs_->FreeMem(bufferHandle);
+        UnreserveMemory(allocator->GetFootprint(bufferHandle));
+        allocator->FreeMem(bufferHandle);
         GRAPHIC_LOGW("Alloc buffer failed to shared memory segment.");
     }
     return buffer;
 }
 
-SurfaceBufferImpl* BufferManager::AllocBuffer(uint32_t size, uint32_t usage)
+SurfaceBufferImpl* BufferManager::AllocBuffer(uint32_t size, uint32_t usage, uint32_t flags)
 {
-    RETURN_VAL_IF_FAIL((grallocFucs_ != nullptr), nullptr);
+    RETURN_VAL_IF_FAIL((gralloc_ != nullptr), nullptr);
     AllocInfo info = {0};
     info.expectedSize = size;
     info.format = PIXEL_FMT_RGB_565;
@@ -160,20 +525,27 @@ SurfaceBufferImpl* BufferManager::AllocBuffer(uint32_t size, uint32_t usage)
         return nullptr;
     }
     info.usage |= HBM_USE_ASSIGN_SIZE;
-    SurfaceBufferImpl* buffer = AllocBuffer(info);
+    SurfaceBufferImpl* buffer = AllocBuffer(info, SelectAllocator(usage, flags));
     if (buffer == nullptr) {
         GRAPHIC_LOGE("Alloc graphic buffer failed");
         return nullptr;
     }
     buffer->SetUsage(usage);
+    InitPlanes(*buffer, IMAGE_PIXEL_FORMAT_NONE, 0);
     return buffer;
 }
 
-SurfaceBufferImpl* BufferManager::AllocBuffer(uint32_t width, uint32_t height, uint32_t format, uint32_t usage)
+SurfaceBufferImpl* BufferManager::AllocBuffer(uint32_t width, uint32_t height, uint32_t format, uint32_t usage,
+    uint32_t flags)
 {
-    RETURN_VAL_IF_FAIL((grallocFucs_ != nullptr), nullptr);
+    RETURN_VAL_IF_FAIL((gralloc_ != nullptr), nullptr);
     AllocInfo info = {0};
     info.width = width;
+    if ((flags & BUFFER_ALLOC_FLAG_ALIGN_64) != 0) {
+        /* Rows of 64 pixels are multiple of 64 bytes in any format, and stay so after the power of 2 stride
+         * alignment of the backend. The base address is page or 64 bytes aligned by all backends. */
+        info.width = (width + SIMD_ALIGNMENT - 1) & ~(SIMD_ALIGNMENT - 1);
+    }
     info.height = height;
     if (!ConvertUsage(info.usage, usage)) {
         GRAPHIC_LOGW("Alloc graphic buffer failed --- conversion usage.");
@@ -183,40 +555,119 @@ SurfaceBufferImpl* BufferManager::AllocBuffer(uint32_t width, uint32_t height, u
         GRAPHIC_LOGW("Alloc graphic buffer failed --- conversion format.");
         return nullptr;
     }
-    SurfaceBufferImpl* buffer = AllocBuffer(info);
+    SurfaceBufferImpl* buffer = AllocBuffer(info, SelectAllocator(usage, flags));
     if (buffer == nullptr) {
         GRAPHIC_LOGE("Alloc graphic buffer failed");
         return nullptr;
     }
     buffer->SetUsage(usage);
+    buffer->SetWidthAndHeight(width, height);
+    buffer->SetFormat(format);
+    InitPlanes(*buffer, format, height);
     return buffer;
 }
 
 void BufferManager::FreeBuffer(SurfaceBufferImpl** buffer)
 {
-    RETURN_IF_FAIL((grallocFucs_ != nullptr));
+    ReleaseBuffer(buffer, true);
+}
+
+void BufferManager::ReleaseBuffer(SurfaceBufferImpl** buffer, bool recycle)
+{
+    RETURN_IF_FAIL((gralloc_ != nullptr));
     if ((*buffer) == nullptr) {
         GRAPHIC_LOGW("Input param buffer is null.");
         return;
     }
     BufferKey key = {(*buffer)->GetKey(), (*buffer)->GetPhyAddr()};
-    auto iter = bufferHandleMap_.find(key);
-    if (iter == bufferHandleMap_.end()) {
+    RegistryShard& shard = GetShard(key);
+    pthread_mutex_lock(&shard.lock);
+    auto iter = shard.bufferHandleMap.find(key);
+    if ((iter == shard.bufferHandleMap.end()) || iter->second.imported) {
+        pthread_mutex_unlock(&shard.lock);
         return;
     }
-    BufferHandle* bufferHandle = iter->second;
-    if (grallocFucs_->FreeMem != nullptr) {
-        grallocFucs_->FreeMem(bufferHandle);
-        bufferHandleMap_.erase(key);
-        delete *buffer;
-        *buffer = nullptr;
-        GRAPHIC_LOGD("Free buffer succeed.");
+    BufferEntry entry = iter->second;
+    shard.bufferHandleMap.erase(iter);
+    pthread_mutex_unlock(&shard.lock);
+    pthread_mutex_lock(&cacheLock_);
+    usedBytes_ -= entry.allocator->GetFootprint(entry.handle);
+    pthread_mutex_unlock(&cacheLock_);
+    if (!recycle || !PutCachedHandle(entry)) {
+        entry.allocator->FreeMem(entry.handle);
     }
+    delete *buffer;
+    *buffer = nullptr;
+    GRAPHIC_LOGD("Free buffer succeed.");
 }
 
-bool BufferManager::MapBuffer(SurfaceBufferImpl& buffer) const
+bool BufferManager::FindEntry(const BufferKey& key, BufferEntry& entry)
 {
-    RETURN_VAL_IF_FAIL((grallocFucs_ != nullptr), false);
+    bool found = false;
+    RegistryShard& shard = GetShard(key);
+    pthread_mutex_lock(&shard.lock);
+    auto iter = shard.bufferHandleMap.find(key);
+    if (iter != shard.bufferHandleMap.end()) {
+        entry = iter->second;
+        found = true;
+    }
+    pthread_mutex_unlock(&shard.lock);
+    return found;
+}
+
+void BufferManager::DeferFreeBuffer(SurfaceBufferImpl* buffer)
+{
+    RETURN_IF_FAIL(buffer);
+    pthread_mutex_lock(&reclaimLock_);
+    reclaimList_.push_back(buffer);
+    pthread_mutex_unlock(&reclaimLock_);
+    if (!BufferWorker::GetInstance()->Post(this, ReclaimWork)) {
+        ReclaimBuffers();
+    }
+}
+
+void BufferManager::ReclaimWork(void* owner)
+{
+    static_cast<BufferManager*>(owner)->ReclaimBuffers();
+}
+
+void BufferManager::ReclaimBuffers()
+{
+    std::list<SurfaceBufferImpl*> buffers;
+    pthread_mutex_lock(&reclaimLock_);
+    buffers.swap(reclaimList_);
+    pthread_mutex_unlock(&reclaimLock_);
+    std::list<SurfaceBufferImpl*>::iterator iter;
+    for (iter = buffers.begin(); iter != buffers.end(); ++iter) {
+        SurfaceBufferImpl* buffer = *iter;
+        FreeBuffer(&buffer);
+    }
+}
+
+void BufferManager::FlushDeferredFree()
+{
+    /* Wait for the running reclaim work, then free the rest in this thread. */
+    BufferWorker::GetInstance()->Cancel(this);
+    ReclaimBuffers();
+}
+
+bool BufferManager::MapBuffer(SurfaceBufferImpl& buffer)
+{
+    RETURN_VAL_IF_FAIL((gralloc_ != nullptr), false);
+    BufferKey key = {buffer.GetKey(), buffer.GetPhyAddr()};
+    RegistryShard& shard = GetShard(key);
+    pthread_mutex_lock(&shard.lock);
+    auto iter = shard.bufferHandleMap.find(key);
+    if (iter != shard.bufferHandleMap.end()) {
+        if (iter->second.imported) {
+            iter->second.mapCount++;
+        }
+        buffer.SetVirAddr(iter->second.handle->virAddr);
+        pthread_mutex_unlock(&shard.lock);
+        return true;
+    }
+    pthread_mutex_unlock(&shard.lock);
+
     void* virAddr = nullptr;
     BufferHandle* bufferHandle = AllocateBufferHandle(buffer);
     if (bufferHandle == nullptr) {
@@ -225,13 +676,9 @@ bool BufferManager::MapBuffer(SurfaceBufferImpl& buffer) const
     if (buffer.GetUsage() == BUFFER_CONSUMER_USAGE_HARDWARE ||
         buffer.GetUsage() == BUFFER_CONSUMER_USAGE_HARDWARE_CONSUMER_CACHE ||
         buffer.GetUsage() == BUFFER_CONSUMER_USAGE_SORTWARE) {
-        if (grallocFucs_->Mmap != nullptr) {
-            virAddr = grallocFucs_->Mmap(bufferHandle);
-        }
+        virAddr = gralloc_->Mmap(bufferHandle);
     } else if (buffer.GetUsage() == BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE) {
-        if (grallocFucs_->MmapCache != nullptr) {
-            virAddr = grallocFucs_->MmapCache(bufferHandle);
-        }
+        virAddr = gralloc_->MmapCache(bufferHandle);
     } else {
         GRAPHIC_LOGE("No support usage.");
         free(bufferHandle);
@@ -242,42 +689,138 @@ bool BufferManager::MapBuffer(SurfaceBufferImpl& buffer) const
         free(bufferHandle);
         return false;
     }
+    bufferHandle->virAddr = virAddr;
+
+    pthread_mutex_lock(&shard.lock);
+    iter = shard.bufferHandleMap.find(key);
+    if (iter != shard.bufferHandleMap.end()) {
+        /* mapped by other thread meanwhile, use the registered mapping. */
+        if (iter->second.imported) {
+            iter->second.mapCount++;
+        }
+        buffer.SetVirAddr(iter->second.handle->virAddr);
+        pthread_mutex_unlock(&shard.lock);
+        gralloc_->Unmap(bufferHandle);
+        free(bufferHandle);
+        return true;
+    }
+    BufferEntry entry = {bufferHandle, gralloc_, {0}, true, 1};
+    shard.bufferHandleMap.insert(std::make_pair(key, entry));
+    pthread_mutex_unlock(&shard.lock);
     buffer.SetVirAddr(virAddr);
     GRAPHIC_LOGD("Map Buffer succeed.");
-    free(bufferHandle);
     return true;
 }
 
-void BufferManager::UnmapBuffer(SurfaceBufferImpl& buffer) const
+void BufferManager::UnmapBuffer(SurfaceBufferImpl& buffer)
 {
-    RETURN_IF_FAIL((grallocFucs_ != nullptr));
-    BufferHandle* bufferHandle = AllocateBufferHandle(buffer);
-    if (bufferHandle == nullptr) {
+    RETURN_IF_FAIL((gralloc_ != nullptr));
+    BufferKey key = {buffer.GetKey(), buffer.GetPhyAddr()};
+    RegistryShard& shard = GetShard(key);
+    pthread_mutex_lock(&shard.lock);
+    auto iter = shard.bufferHandleMap.find(key);
+    if ((iter == shard.bufferHandleMap.end()) || !iter->second.imported) {
+        /* not mapped, or allocated by this process, the mapping is released when freed. */
+        pthread_mutex_unlock(&shard.lock);
         return;
     }
-    if ((grallocFucs_->Unmap == nullptr) || (grallocFucs_->Unmap(bufferHandle) != DISPLAY_SUCCESS)) {
+    if (--iter->second.mapCount > 0) {
+        pthread_mutex_unlock(&shard.lock);
+        return;
+    }
+    BufferHandle* bufferHandle = iter->second.handle;
+    BufferAllocator* allocator = iter->second.allocator;
+    shard.bufferHandleMap.erase(iter);
+    pthread_mutex_unlock(&shard.lock);
+    if (allocator->Unmap(bufferHandle) != DISPLAY_SUCCESS) {
         GRAPHIC_LOGE("Umap buffer failed.");
     }
     free(bufferHandle);
 }
 
-int32_t BufferManager::FlushCache(SurfaceBufferImpl& buffer) const
+int32_t BufferManager::FlushCache(SurfaceBufferImpl& buffer)
 {
-    RETURN_VAL_IF_FAIL((grallocFucs_ != nullptr), SURFACE_ERROR_NOT_READY);
-    BufferHandle* bufferHandle = AllocateBufferHandle(buffer);
-    if (bufferHandle == nullptr) {
+    RETURN_VAL_IF_FAIL((gralloc_ != nullptr), SURFACE_ERROR_NOT_READY);
+    BufferKey key = {buffer.GetKey(), buffer.GetPhyAddr()};
+    BufferEntry entry;
+    if (!FindEntry(key, entry)) {
+        GRAPHIC_LOGE("Flush cache of unknown buffer.");
         return -1;
     }
     if (buffer.GetUsage() == BUFFER_CONSUMER_USAGE_HARDWARE_CONSUMER_CACHE) {
-        if ((grallocFucs_->FlushCache == nullptr) || (grallocFucs_->FlushCache(bufferHandle) != DISPLAY_SUCCESS)) {
+        if (entry.allocator->FlushCache(entry.handle) != DISPLAY_SUCCESS) {
             GRAPHIC_LOGE("Flush cache buffer failed.");
         }
     } else if (buffer.GetUsage() == BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE) {
-        if ((grallocFucs_->FlushMCache == nullptr) || (grallocFucs_->FlushMCache(bufferHandle) != DISPLAY_SUCCESS)) {
+        if (entry.allocator->FlushMCache(entry.handle) != DISPLAY_SUCCESS) {
             GRAPHIC_LOGE("Flush M cache buffer failed.");
         }
     }
-    free(bufferHandle);
     return SURFACE_ERROR_OK;
 }
+
+int32_t BufferManager::SyncCacheRange(SurfaceBufferImpl& buffer, uint32_t offset, uint32_t length, bool flush)
+{
+    RETURN_VAL_IF_FAIL((gralloc_ != nullptr), SURFACE_ERROR_NOT_READY);
+    int32_t (BufferAllocator::*syncFunc)(BufferHandle*) = nullptr;
+    if (!flush) {
+        syncFunc = &BufferAllocator::InvalidateCache;
+    } else if (buffer.GetUsage() == BUFFER_CONSUMER_USAGE_HARDWARE_CONSUMER_CACHE) {
+        syncFunc = &BufferAllocator::FlushCache;
+    } else if (buffer.GetUsage() == BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE) {
+        syncFunc = &BufferAllocator::FlushMCache;
+    }
+    if (syncFunc == nullptr) {
+        return SURFACE_ERROR_OK;
+    }
+    BufferKey key = {buffer.GetKey(), buffer.GetPhyAddr()};
+    BufferEntry entry;
+    if (!FindEntry(key, entry)) {
+        GRAPHIC_LOGE("Sync cache of unknown buffer.");
+        return -1;
+    }
+    BufferHandle* bufferHandle = entry.handle;
+    uint64_t size = static_cast<uint64_t>(bufferHandle->size);
+    uint64_t begin = offset & ~(CACHE_LINE_SIZE - 1);
+    uint64_t end = (static_cast<uint64_t>(offset) + length + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+    end = (end > size) ? size : end;
+    if (begin >= end) {
+        return SURFACE_ERROR_OK;
+    }
+    /* The range handle is a copy per call, the backend runs out of the registry lock. */
+    uint64_t rangeData[RANGE_HANDLE_WORDS];
+    uint32_t total = (bufferHandle->reserveFds + bufferHandle->reserveInts) * sizeof(int32_t) + sizeof(BufferHandle);
+    BufferHandle* rangeHandle = reinterpret_cast<BufferHandle *>(rangeData);
+    if (total > sizeof(rangeData)) {
+        rangeHandle = static_cast<BufferHandle *>(malloc(total));
+        RETURN_VAL_IF_FAIL(rangeHandle, SURFACE_ERROR_SYSTEM_ERROR);
+    }
+    int32_t ret = SURFACE_ERROR_SYSTEM_ERROR;
+    if (memcpy_s(rangeHandle, total, bufferHandle, total) == EOK) {
+        rangeHandle->virAddr = static_cast<uint8_t *>(bufferHandle->virAddr) + begin;
+        if (bufferHandle->phyAddr != 0) {
+            rangeHandle->phyAddr = bufferHandle->phyAddr + begin;
+        }
+        rangeHandle->size = static_cast<int32_t>(end - begin);
+        ret = (entry.allocator->*syncFunc)(rangeHandle);
+    }
+    if (rangeHandle != reinterpret_cast<BufferHandle *>(rangeData)) {
+        free(rangeHandle);
+    }
+    if (ret != DISPLAY_SUCCESS) {
+        GRAPHIC_LOGE("Sync cache range failed, flush=%d.", flush);
+        return SURFACE_ERROR_SYSTEM_ERROR;
+    }
+    return SURFACE_ERROR_OK;
+}
+
+int32_t BufferManager::FlushCache(SurfaceBufferImpl& buffer, uint32_t offset, uint32_t length)
+{
+    return SyncCacheRange(buffer, offset, length, true);
+}
+
+int32_t BufferManager::InvalidateCache(SurfaceBufferImpl& buffer, uint32_t offset, uint32_t length)
+{
+    return SyncCacheRange(buffer, offset, length, false);
+}
 } // namespace OHOS
@@ -16,12 +16,26 @@
 #ifndef GRAPHIC_LITE_BUFFER_MANAGER_H
 #define GRAPHIC_LITE_BUFFER_MANAGER_H
 
+#include <list>
 #include <map>
-#include "display_gralloc.h"
+#include <pthread.h>
+#include "buffer_allocator.h"
 #include "surface_buffer_impl.h"
 #include "surface_type.h"
 
 namespace OHOS {
+class BufferQueue;
+
+/**
+ * @brief Statistics of the buffer recycling cache.
+ */
+struct BufferCacheStats {
+    uint32_t hits;        /* allocations served by a recycled buffer */
+    uint32_t misses;      /* allocations which have to alloc from gralloc */
+    uint32_t evictions;   /* recycled buffers freed to stay in the byte budget */
+    uint32_t cachedBytes; /* bytes of recycled buffers held by the cache */
+};
+
 /**
  * @brief Buffer Manager abstract class. Provide allocate, free, map, unmap buffer attr ability.
  *        It needs vendor to adapte it. Default Hisi support shm and physical memory.
@@ -45,9 +59,10 @@ public:
      * @brief Allocate buffer for producer.
      * @param [in] size, alloc buffer size.
      * @param [in] usage, alloc buffer usage.
+     * @param [in] flags, alloc flags, combination of BufferAllocFlag.
      * @returns buffer pointer.
      */
-    SurfaceBufferImpl* AllocBuffer(uint32_t size, uint32_t usage);
+    SurfaceBufferImpl* AllocBuffer(uint32_t size, uint32_t usage, uint32_t flags = BUFFER_ALLOC_FLAG_NONE);
 
     /**
      * @brief Allocate buffer for producer.
@@ -55,9 +70,12 @@ public:
      * @param [in] height, alloc buffer height.
      * @param [in] format, alloc buffer format.
      * @param [in] usage, alloc buffer usage.
+     * @param [in] flags, alloc flags, combination of BufferAllocFlag. With BUFFER_ALLOC_FLAG_ALIGN_64, the width
+     *        is allocated in multiple of 64 pixels, so that rows of any format are multiple of 64 bytes.
      * @returns buffer pointer.
      */
-    SurfaceBufferImpl* AllocBuffer(uint32_t width, uint32_t height, uint32_t format, uint32_t usage);
+    SurfaceBufferImpl* AllocBuffer(uint32_t width, uint32_t height, uint32_t format, uint32_t usage,
+        uint32_t flags = BUFFER_ALLOC_FLAG_NONE);
 
     /**
      * @brief Free the buffer.
@@ -65,37 +83,164 @@ public:
      */
     void FreeBuffer(SurfaceBufferImpl** buffer);
 
+    /**
+     * @brief Free the buffer, optionally bypassing the buffer cache.
+     * @param [in] SurfaceBufferImpl double pointer, the buffer to free.
+     * @param [in] recycle, whether the memory may be kept in the buffer cache, or returned to the system.
+     */
+    void ReleaseBuffer(SurfaceBufferImpl** buffer, bool recycle);
+
+    /**
+     * @brief Free the buffer later on the buffer worker thread, so that callers holding a lock are not stalled
+     *        by gralloc free and unmap.
+     * @param [in] SurfaceBufferImpl pointer, the buffer to free.
+     */
+    void DeferFreeBuffer(SurfaceBufferImpl* buffer);
+
+    /**
+     * @brief Free all deferred buffers synchronously, used for shutdown and tests.
+     */
+    void FlushDeferredFree();
+
     /**
      * @brief Flush the buffer.
      * @param [in] Flush SurfaceBufferImpl cache to physical memory.
      * @returns 0 is succeed; other is failed.
      */
-    int32_t FlushCache(SurfaceBufferImpl& buffer) const;
+    int32_t FlushCache(SurfaceBufferImpl& buffer);
 
     /**
-     * @brief Map the buffer for producer.
+     * @brief Flush the cache of a byte range of the buffer. The range is expanded to cache line boundary.
+     * @param [in] SurfaceBufferImpl, need to flush.
+     * @param [in] offset, start offset of the range.
+     * @param [in] length, length of the range.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t FlushCache(SurfaceBufferImpl& buffer, uint32_t offset, uint32_t length);
+
+    /**
+     * @brief Invalidate the cache of a byte range of the buffer, before CPU reads the data written by device.
+     *        The range is expanded to cache line boundary.
+     * @param [in] SurfaceBufferImpl, need to invalidate.
+     * @param [in] offset, start offset of the range.
+     * @param [in] length, length of the range.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t InvalidateCache(SurfaceBufferImpl& buffer, uint32_t offset, uint32_t length);
+
+    /**
+     * @brief Map the buffer for producer. The buffer handle is built once and kept in the registry until the
+     *        last unmap, buffers allocated by this process are returned with their existing mapping.
      * @param [in] SurfaceBufferImpl, need to map.
      * @returns Whether map buffer succeed or not.
      */
-    bool MapBuffer(SurfaceBufferImpl& buffer) const;
+    bool MapBuffer(SurfaceBufferImpl& buffer);
 
     /**
      * @brief Unmap the buffer, which producer could not writed data.
      * @param [in] SurfaceBufferImpl, need to unmap.
      */
-    void UnmapBuffer(SurfaceBufferImpl& buffer) const;
+    void UnmapBuffer(SurfaceBufferImpl& buffer);
+
+    /**
+     * @brief Set the byte budget of the recycling cache. Freed buffers are kept in the cache and reused by
+     *        the next allocation with the same width, height, format, size and usage, instead of freeing to
+     *        and allocating from gralloc again. Least recently freed buffers are evicted first when the budget
+     *        is exceeded. The content of a recycled buffer is undefined.
+     * @param [in] budget, max bytes held by the cache. 0 is disable the cache and free all cached buffers.
+     */
+    void SetCacheBudget(uint32_t budget);
+
+    /**
+     * @brief Get the statistics of the recycling cache.
+     * @returns cache hit, miss and eviction count, and cached bytes.
+     */
+    BufferCacheStats GetCacheStats();
+
+    /**
+     * @brief Free all buffers held by the recycling cache.
+     */
+    void TrimCache();
+
+    /**
+     * @brief Set the byte budget of all buffers allocated by this process, including the recycling cache.
+     *        When an allocation exceeds the budget, the recycling cache is trimmed first, then the buffers idle
+     *        in free lists of all buffer queues, least recently used first. The allocation fails if the budget
+     *        still could not be met. The memory is reserved before the buffer is allocated.
+     * @param [in] budget, max bytes. 0 is no limit, which is the default.
+     */
+    void SetMemoryBudget(uint64_t budget);
+
+    /**
+     * @brief Get the bytes of all buffers allocated by this process, including the recycling cache.
+     * @returns The used bytes.
+     */
+    uint64_t GetMemoryUsage();
+
+    /**
+     * @brief Register buffer queue, whose idle free buffers could be trimmed under memory pressure.
+     * @param [in] BufferQueue pointer.
+     */
+    void RegisterQueue(BufferQueue* queue);
+
+    /**
+     * @brief Unregister buffer queue. Must not be called with the lock of the queue.
+     * @param [in] BufferQueue pointer.
+     */
+    void UnregisterQueue(BufferQueue* queue);
+
+    /**
+     * @brief Set the default allocator backend of this buffer manager, used by the usages which have no
+     *        allocator of their own. Buffers already allocated are freed by the allocator which allocated them.
+     *        The allocator must outlive all buffers allocated from it, built-in allocators are never destroyed.
+     * @param [in] BufferAllocator pointer, nullptr is restore the gralloc allocator.
+     */
+    void SetAllocator(BufferAllocator* allocator);
+
+    /**
+     * @brief Set the allocator backend for buffers of the usage.
+     * @param [in] usage, buffer usage, the value of BUFFER_CONSUMER_USAGE_*.
+     * @param [in] BufferAllocator pointer, nullptr is use the default allocator.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t SetAllocator(uint32_t usage, BufferAllocator* allocator);
 
 protected:
     BufferHandle* AllocateBufferHandle(SurfaceBufferImpl& buffer) const;
-    SurfaceBufferImpl* AllocBuffer(AllocInfo info);
+    SurfaceBufferImpl* AllocBuffer(AllocInfo info, BufferAllocator* allocator);
     bool ConvertUsage(uint64_t& destUsage, uint32_t srcUsage) const;
     bool ConvertFormat(PixelFormat& destFormat, uint32_t srcFormat) const;
+    void InitPlanes(SurfaceBufferImpl& buffer, uint32_t format, uint32_t height) const;
 
 private:
-    BufferManager() : grallocFucs_(nullptr) {}
-    ~BufferManager() {}
+    BufferManager();
+    ~BufferManager();
+    struct BufferEntry;
+    BufferAllocator* SelectAllocator(uint32_t usage, uint32_t flags);
+    BufferHandle* GetCachedHandle(const AllocInfo& info, BufferAllocator* allocator);
+    bool PutCachedHandle(const BufferEntry& entry);
+    void FreeHandles(std::list<BufferEntry>& entries);
+    static void ReclaimWork(void* owner);
+    void ReclaimBuffers();
+    bool ReserveMemory(uint32_t size);
+    void UnreserveMemory(uint32_t size);
+    BufferHandle* AllocHandle(const AllocInfo& info, BufferAllocator* allocator);
+    struct IdleBuffer {
+        int64_t idleTime;
+        BufferQueue* queue;
+        SurfaceBufferImpl* buffer;
+        bool operator < (const IdleBuffer &x) const
+        {
+            return idleTime < x.idleTime;
+        }
+    };
+    void CollectIdleBuffers(std::list<IdleBuffer>& idleBuffers);
+    bool TrimIdleBuffer(std::list<IdleBuffer>& idleBuffers);
 
-    GrallocFuncs* grallocFucs_;
+    BufferAllocator* gralloc_;   /* maps buffers imported from other processes */
+    BufferAllocator* allocator_; /* default allocator, guarded by initLock_ as usageAllocators_ */
+    BufferAllocator* usageAllocators_[BUFFER_CONSUMER_USAGE_MAX];
+    pthread_mutex_t initLock_;
     struct BufferKey {
         int32_t key;
         uint64_t phyAddr;
@@ -104,7 +249,34 @@ private:
             return (key < x.key) || (key == x.key && phyAddr < x.phyAddr);
         }
     };
-    std::map<BufferKey, BufferHandle*> bufferHandleMap_;
+    struct BufferEntry {
+        BufferHandle* handle;
+        BufferAllocator* allocator; /* allocator which allocated or mapped the handle */
+        AllocInfo info;
+        bool imported;     /* handle is mapped from a buffer allocated by other process */
+        uint32_t mapCount; /* map count of imported handle */
+    };
+    bool FindEntry(const BufferKey& key, BufferEntry& entry);
+    int32_t SyncCacheRange(SurfaceBufferImpl& buffer, uint32_t offset, uint32_t length, bool flush);
+    /* The registry is split into shards by the hash of BufferKey, each shard has its own lock, so that
+     * surfaces alloc and free buffers concurrently without contending on a single lock. */
+    static const uint32_t REGISTRY_SHARD_NUM = 16;
+    struct RegistryShard {
+        pthread_mutex_t lock;
+        std::map<BufferKey, BufferEntry> bufferHandleMap;
+    };
+    RegistryShard& GetShard(const BufferKey& key);
+    RegistryShard registry_[REGISTRY_SHARD_NUM];
+    std::list<BufferEntry> cacheList_;
+    uint32_t cacheBudget_;
+    BufferCacheStats cacheStats_;
+    pthread_mutex_t cacheLock_;
+    std::list<SurfaceBufferImpl*> reclaimList_;
+    pthread_mutex_t reclaimLock_;
+    uint64_t memoryBudget_;
+    uint64_t usedBytes_; /* bytes of buffers in use, guarded by cacheLock_ as the cached bytes */
+    std::list<BufferQueue*> queues_;
+    pthread_mutex_t queuesLock_;
 };
 } // end namespace
 #endif
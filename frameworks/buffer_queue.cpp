@@ -15,11 +15,17 @@
 
 #include "buffer_queue.h"
 
+#include <algorithm>
 #include <list>
 #include <string>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "buffer_blob_pool.h"
 #include "buffer_common.h"
 #include "buffer_manager.h"
+#include "buffer_worker.h"
 
 namespace OHOS {
 const int32_t BUFFER_STRIDE_ALIGNMENT_DEFAULT = 4;
@@ -28,6 +34,45 @@ const uint8_t BUFFER_QUEUE_SIZE_MAX = 10;
 const int32_t BUFFER_CONSUMER_USAGE_DEFAULT = BUFFER_CONSUMER_USAGE_SORTWARE;
 const uint8_t USER_DATA_COUNT = 100;
 
+static int64_t GetNowMs()
+{
+    struct timespec now = {0};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000 + now.tv_nsec / 1000000; // 1000: ms per sec, 1000000: ns per ms
+}
+
+static uint32_t GetBytesPerPixel(uint32_t format)
+{
+    switch (format) {
+        case IMAGE_PIXEL_FORMAT_RGB565:
+        case IMAGE_PIXEL_FORMAT_ARGB1555:
+            return 2; // 2 bytes per pixel
+        case IMAGE_PIXEL_FORMAT_RGB888:
+            return 3; // 3 bytes per pixel
+        case IMAGE_PIXEL_FORMAT_ARGB8888:
+            return 4; // 4 bytes per pixel
+        default:
+            return 1; // luma plane of yuv formats
+    }
+}
+
+/* Size of the planes in rows of the stride, as the buffer manager lays them out. */
+static uint64_t GetPlanesSize(uint32_t height, uint32_t format, uint32_t stride)
+{
+    uint64_t lumaSize = static_cast<uint64_t>(stride) * height;
+    uint64_t chromaHeight = (static_cast<uint64_t>(height) + 1) / 2; // 4:2:0 chroma planes have half rows, rounded up
+    switch (format) {
+        case IMAGE_PIXEL_FORMAT_NV12:
+        case IMAGE_PIXEL_FORMAT_NV21:
+            return lumaSize + stride * chromaHeight;
+        case IMAGE_PIXEL_FORMAT_YUV420:
+        case IMAGE_PIXEL_FORMAT_YVU420:
+            return lumaSize + 2 * ((stride + 1) / 2) * chromaHeight; // 2 chroma planes of half stride
+        default:
+            return lumaSize;
+    }
+}
+
 BufferQueue::BufferQueue()
     : width_(0),
       height_(0),
@@ -37,29 +82,60 @@ BufferQueue::BufferQueue()
       size_(0),
       queueSize_(BUFFER_QUEUE_SIZE_DEFAULT),
       strideAlignment_(BUFFER_STRIDE_ALIGNMENT_DEFAULT),
+      allocFlags_(BUFFER_ALLOC_FLAG_NONE),
       attachCount_(0),
-      customSize_(false)
+      allocCount_(0),
+      allocFailed_(false),
+      resetGeneration_(0),
+      attrGeneration_(0),
+      customSize_(false),
+      dirtyEventFd_(-1),
+      freeEventFd_(-1),
+      dirtyReady_(false),
+      freeReady_(false),
+      generation_(0),
+      idleTimeout_(0),
+      idleFloor_(0),
+      idleScheduled_(false),
+      lastRequestTime_(0),
+      blobPool_(BlobPool::Create())
 {
 }
 
 BufferQueue::~BufferQueue()
 {
+    BufferManager* manager = BufferManager::GetInstance();
+    if (manager != nullptr) {
+        manager->UnregisterQueue(this);
+    }
+    BufferWorker::GetInstance()->Cancel(this);
     pthread_mutex_lock(&lock_);
     freeList_.clear();
     dirtyList_.clear();
     std::list<SurfaceBufferImpl *>::iterator iterBuffer;
     for (iterBuffer = allBuffers_.begin(); iterBuffer != allBuffers_.end(); ++iterBuffer) {
         SurfaceBufferImpl* tmpBuffer = *iterBuffer;
+        tmpBuffer->SetBlobPool(nullptr);
         BufferManager* bufferManager = BufferManager::GetInstance();
         if (bufferManager == nullptr) {
             continue;
         }
-        bufferManager->FreeBuffer(&tmpBuffer);
+        bufferManager->DeferFreeBuffer(tmpBuffer);
     }
     allBuffers_.clear();
+    if (dirtyEventFd_ >= 0) {
+        close(dirtyEventFd_);
+        dirtyEventFd_ = -1;
+    }
+    if (freeEventFd_ >= 0) {
+        close(freeEventFd_);
+        freeEventFd_ = -1;
+    }
     pthread_mutex_unlock(&lock_);
     pthread_cond_destroy(&freeCond_);
     pthread_mutex_destroy(&lock_);
+    /* Blobs still held by deferred freed buffers keep the pool alive until they are freed. */
+    blobPool_->Release();
 }
 
 bool BufferQueue::Init()
@@ -73,60 +149,301 @@ bool BufferQueue::Init()
         pthread_mutex_destroy(&lock_);
         return false;
     }
+    BufferManager* manager = BufferManager::GetInstance();
+    if (manager != nullptr) {
+        manager->RegisterQueue(this);
+    }
     return true;
 }
 
-void BufferQueue::NeedAttach()
+bool BufferQueue::CanAttach()
 {
-    if (queueSize_ == attachCount_) {
-        GRAPHIC_LOGI("has alloced %d buffer, could not alloc more.", allBuffers_.size());
-        return;
+    if (attachCount_ + allocCount_ >= queueSize_) {
+        return false;
     }
-    if (size_ == 0 && isValidAttr(width_, height_, format_, strideAlignment_) != SURFACE_ERROR_OK) {
-        GRAPHIC_LOGI("Invalid Attr.");
+    return size_ != 0 || isValidAttr(width_, height_, format_, strideAlignment_) == SURFACE_ERROR_OK;
+}
+
+int32_t BufferQueue::GetEventFd(int32_t& fd, bool& ready)
+{
+    pthread_mutex_lock(&lock_);
+    if (fd < 0) {
+        fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0) {
+            GRAPHIC_LOGE("Create event fd failed.");
+        }
+        ready = false;
+        UpdateReadiness();
+    }
+    int32_t ret = fd;
+    pthread_mutex_unlock(&lock_);
+    return ret;
+}
+
+void BufferQueue::SetEventFdReady(int32_t fd, bool& ready, bool newReady)
+{
+    if (fd < 0 || ready == newReady) {
         return;
     }
+    if (newReady) {
+        eventfd_write(fd, 1);
+    } else {
+        eventfd_t value;
+        eventfd_read(fd, &value);
+    }
+    ready = newReady;
+}
+
+void BufferQueue::UpdateReadiness()
+{
+    SetEventFdReady(dirtyEventFd_, dirtyReady_, !dirtyList_.empty());
+    SetEventFdReady(freeEventFd_, freeReady_, !freeList_.empty() || CanAttach());
+}
+
+int32_t BufferQueue::GetDirtyEventFd()
+{
+    return GetEventFd(dirtyEventFd_, dirtyReady_);
+}
+
+int32_t BufferQueue::GetFreeEventFd()
+{
+    return GetEventFd(freeEventFd_, freeReady_);
+}
+
+void BufferQueue::GetFreeBuffers(std::list<std::pair<int64_t, SurfaceBufferImpl*>>& buffers)
+{
+    pthread_mutex_lock(&lock_);
+    std::list<SurfaceBufferImpl *>::iterator iter;
+    for (iter = freeList_.begin(); iter != freeList_.end(); ++iter) {
+        buffers.push_back(std::make_pair((*iter)->GetIdleTime(), *iter));
+    }
+    pthread_mutex_unlock(&lock_);
+}
+
+bool BufferQueue::TrimFree(SurfaceBufferImpl* buffer)
+{
+    pthread_mutex_lock(&lock_);
+    std::list<SurfaceBufferImpl *>::iterator iter = std::find(freeList_.begin(), freeList_.end(), buffer);
+    if (iter == freeList_.end()) {
+        pthread_mutex_unlock(&lock_);
+        return false;
+    }
+    freeList_.erase(iter);
+    allBuffers_.remove(buffer);
+    attachCount_--;
+    generation_++;
+    UpdateReadiness();
+    pthread_mutex_unlock(&lock_);
+    return true;
+}
+
+uint32_t BufferQueue::GetGeneration()
+{
+    pthread_mutex_lock(&lock_);
+    uint32_t generation = generation_;
+    pthread_mutex_unlock(&lock_);
+    return generation;
+}
+
+uint32_t BufferQueue::GetConfigGeneration()
+{
+    pthread_mutex_lock(&lock_);
+    uint32_t generation = attrGeneration_;
+    pthread_mutex_unlock(&lock_);
+    return generation;
+}
+
+void BufferQueue::GetConfig(BufferQueueConfig& config)
+{
+    pthread_mutex_lock(&lock_);
+    config.width = width_;
+    config.height = height_;
+    config.format = format_;
+    config.stride = stride_;
+    config.size = size_;
+    config.usage = usage_;
+    config.strideAlignment = strideAlignment_;
+    config.queueSize = queueSize_;
+    config.generation = attrGeneration_;
+    pthread_mutex_unlock(&lock_);
+}
+
+bool BufferQueue::NeedAttach()
+{
+    if (!CanAttach()) {
+        GRAPHIC_LOGI("has alloced %d buffer, could not alloc more.", allBuffers_.size());
+        return false;
+    }
     BufferManager* bufferManager = BufferManager::GetInstance();
-    RETURN_IF_FAIL(bufferManager);
+    RETURN_VAL_IF_FAIL(bufferManager, false);
+    uint32_t width = width_;
+    uint32_t height = height_;
+    uint32_t format = format_;
+    uint32_t usage = usage_;
+    uint32_t size = size_;
+    uint32_t allocFlags = allocFlags_;
+    bool customSize = customSize_;
+    uint32_t resetGeneration = resetGeneration_;
+    allocCount_++;
+    /* Alloc out of lock, so that a slow gralloc does not block other producers and consumers. */
+    pthread_mutex_unlock(&lock_);
     SurfaceBufferImpl *buffer = nullptr;
-    if (size_ != 0 && customSize_) {
-        buffer = bufferManager->AllocBuffer(size_, usage_);
+    if (size != 0 && customSize) {
+        buffer = bufferManager->AllocBuffer(size, usage, allocFlags);
     } else {
-        buffer = bufferManager->AllocBuffer(width_, height_, format_, usage_);
+        buffer = bufferManager->AllocBuffer(width, height, format, usage, allocFlags);
     }
+    pthread_mutex_lock(&lock_);
+    allocCount_--;
     if (buffer == nullptr) {
         GRAPHIC_LOGI("BufferManager alloc memory failed ");
-        return;
+        allocFailed_ = true;
+        return false;
+    }
+    if (resetGeneration != resetGeneration_ || attachCount_ >= queueSize_) {
+        GRAPHIC_LOGI("Buffer config changed during alloc, discard it.");
+        pthread_mutex_unlock(&lock_);
+        bufferManager->FreeBuffer(&buffer);
+        pthread_mutex_lock(&lock_);
+        return true;
+    }
+    if (size_ != buffer->GetSize() || stride_ != static_cast<uint32_t>(buffer->GetStride())) {
+        size_ = buffer->GetSize();
+        stride_ = buffer->GetStride();
+        attrGeneration_++;
     }
-    size_ = buffer->GetSize();
-    stride_ = buffer->GetStride();
     attachCount_++;
+    buffer->SetBlobPool(blobPool_);
+    buffer->SetIdleTime(GetNowMs());
+    AssignSlot(*buffer);
     freeList_.push_back(buffer);
     allBuffers_.push_back(buffer);
+    return true;
 }
 
-bool BufferQueue::CanRequest(uint8_t wait)
+void BufferQueue::AllocWork(void* owner)
 {
-    bool res = true;
-    if (!freeList_.empty()) {
-        res = true;
-        goto ERROR;
+    BufferQueue* queue = static_cast<BufferQueue*>(owner);
+    pthread_mutex_lock(&queue->lock_);
+    while (queue->NeedAttach()) {
+        queue->UpdateReadiness();
+        pthread_cond_broadcast(&queue->freeCond_);
     }
-    if (attachCount_ < queueSize_) {
-        NeedAttach();
-        res = true;
-        if (freeList_.empty()) {
-            GRAPHIC_LOGI("no buffer in freeQueue for dequeue.");
-            res = false;
-        }
-        goto ERROR;
+    queue->UpdateReadiness();
+    pthread_mutex_unlock(&queue->lock_);
+    pthread_cond_broadcast(&queue->freeCond_);
+}
+
+void BufferQueue::IdleWork(void* owner)
+{
+    BufferQueue* queue = static_cast<BufferQueue*>(owner);
+    pthread_mutex_lock(&queue->lock_);
+    if (queue->idleTimeout_ == 0) {
+        queue->idleScheduled_ = false;
+        pthread_mutex_unlock(&queue->lock_);
+        return;
+    }
+    int64_t idle = GetNowMs() - queue->lastRequestTime_;
+    if (idle < queue->idleTimeout_) {
+        queue->idleScheduled_ =
+            BufferWorker::GetInstance()->PostDelayed(owner, IdleWork, queue->idleTimeout_ - idle);
+        pthread_mutex_unlock(&queue->lock_);
+        return;
+    }
+    queue->idleScheduled_ = false;
+    pthread_mutex_unlock(&queue->lock_);
+    queue->TrimIdle();
+}
+
+uint32_t BufferQueue::TrimIdle()
+{
+    std::list<SurfaceBufferImpl *> idleBuffers;
+    pthread_mutex_lock(&lock_);
+    while (attachCount_ > idleFloor_ && !freeList_.empty()) {
+        SurfaceBufferImpl *buffer = freeList_.front();
+        freeList_.pop_front();
+        allBuffers_.remove(buffer);
+        attachCount_--;
+        idleBuffers.push_back(buffer);
+    }
+    if (!idleBuffers.empty()) {
+        GRAPHIC_LOGI("Surface is idle, free %zu buffers.", idleBuffers.size());
+        generation_++;
+        UpdateReadiness();
     }
-    if (wait) {
+    pthread_mutex_unlock(&lock_);
+    BufferManager* bufferManager = BufferManager::GetInstance();
+    RETURN_VAL_IF_FAIL(bufferManager, 0);
+    uint32_t count = 0;
+    std::list<SurfaceBufferImpl *>::iterator iter;
+    for (iter = idleBuffers.begin(); iter != idleBuffers.end(); ++iter) {
+        SurfaceBufferImpl *buffer = *iter;
+        /* Return the memory to the system rather than the buffer cache, the surface is static. */
+        bufferManager->ReleaseBuffer(&buffer, false);
+        count++;
+    }
+    return count;
+}
+
+int32_t BufferQueue::SetIdlePolicy(uint32_t timeout, uint8_t floor)
+{
+    pthread_mutex_lock(&lock_);
+    if (floor > queueSize_) {
+        GRAPHIC_LOGI("Invalid idle floor(%u).", floor);
+        pthread_mutex_unlock(&lock_);
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    idleTimeout_ = timeout;
+    idleFloor_ = floor;
+    lastRequestTime_ = GetNowMs();
+    if (idleTimeout_ != 0 && !idleScheduled_) {
+        idleScheduled_ = BufferWorker::GetInstance()->PostDelayed(this, IdleWork, idleTimeout_);
+    }
+    pthread_mutex_unlock(&lock_);
+    return SURFACE_ERROR_OK;
+}
+
+int32_t BufferQueue::SetAllocFlags(uint32_t flags)
+{
+    if ((flags & ~static_cast<uint32_t>(BUFFER_ALLOC_FLAG_MASK)) != 0) {
+        GRAPHIC_LOGI("Invalid alloc flags(%u).", flags);
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    pthread_mutex_lock(&lock_);
+    if (allocFlags_ == flags) {
+        pthread_mutex_unlock(&lock_);
+        return SURFACE_ERROR_OK;
+    }
+    allocFlags_ = flags;
+    Reset(customSize_ ? size_ : 0);
+    pthread_mutex_unlock(&lock_);
+    pthread_cond_signal(&freeCond_);
+    return SURFACE_ERROR_OK;
+}
+
+uint32_t BufferQueue::GetAllocFlags()
+{
+    return allocFlags_;
+}
+
+bool BufferQueue::CanRequest(uint8_t wait)
+{
+    while (freeList_.empty()) {
+        /* Allocation is left to the worker, a no-wait request never blocks on it and only starts it. */
+        if (CanAttach()) {
+            allocFailed_ = false;
+            BufferWorker::GetInstance()->Post(this, AllocWork);
+        }
+        if (!wait) {
+            return false;
+        }
         pthread_cond_wait(&freeCond_, &lock_);
-        res = true;
+        if (freeList_.empty() && allocFailed_) {
+            allocFailed_ = false;
+            return false;
+        }
     }
-ERROR:
-    return res;
+    return true;
 }
 
 SurfaceBufferImpl* BufferQueue::RequestBuffer(uint8_t wait)
@@ -144,7 +461,18 @@ SurfaceBufferImpl* BufferQueue::RequestBuffer(uint8_t wait)
     }
     freeList_.pop_front();
     buffer->SetState(BUFFER_STATE_REQUEST);
+    buffer->SetCpuCacheFlushed(false);
+    if (CanAttach()) {
+        /* Top up the queue in background, the next request needs not to alloc. */
+        allocFailed_ = false;
+        BufferWorker::GetInstance()->Post(this, AllocWork);
+    }
+    lastRequestTime_ = GetNowMs();
+    if (idleTimeout_ != 0 && !idleScheduled_) {
+        idleScheduled_ = BufferWorker::GetInstance()->PostDelayed(this, IdleWork, idleTimeout_);
+    }
 ERROR:
+    UpdateReadiness();
     pthread_mutex_unlock(&lock_);
     return buffer;
 }
@@ -161,7 +489,49 @@ SurfaceBufferImpl* BufferQueue::GetBuffer(const SurfaceBufferImpl& buffer)
     return nullptr;
 }
 
-int32_t BufferQueue::FlushBuffer(SurfaceBufferImpl& buffer)
+/*
+ * The lowest slot not used by attached buffers. A slot is reused only after its buffer is removed, which increases
+ * the generation, so that remote producers never refer to the new buffer by the mapping of old one.
+ */
+void BufferQueue::AssignSlot(SurfaceBufferImpl& buffer)
+{
+    uint32_t usedSlots = 0;
+    std::list<SurfaceBufferImpl *>::iterator iterBuffer;
+    for (iterBuffer = allBuffers_.begin(); iterBuffer != allBuffers_.end(); ++iterBuffer) {
+        uint32_t slot = (*iterBuffer)->GetSlot();
+        if (slot < BUFFER_SLOT_MAX) {
+            usedSlots |= (1u << slot);
+        }
+    }
+    buffer.SetSlot(BUFFER_SLOT_INVALID);
+    for (uint32_t slot = 0; slot < BUFFER_SLOT_MAX; slot++) {
+        if ((usedSlots & (1u << slot)) == 0) {
+            buffer.SetSlot(slot);
+            return;
+        }
+    }
+}
+
+bool BufferQueue::GetSlotBuffer(uint32_t slot, int32_t key, SurfaceBufferImpl& buffer)
+{
+    RETURN_VAL_IF_FAIL(slot < BUFFER_SLOT_MAX, false);
+    bool found = false;
+    pthread_mutex_lock(&lock_);
+    std::list<SurfaceBufferImpl *>::iterator iterBuffer;
+    for (iterBuffer = allBuffers_.begin(); iterBuffer != allBuffers_.end(); ++iterBuffer) {
+        SurfaceBufferImpl *tmpBuffer = *iterBuffer;
+        if (tmpBuffer->GetSlot() == slot && tmpBuffer->GetKey() == key) {
+            buffer.SetKey(tmpBuffer->GetKey());
+            buffer.SetPhyAddr(tmpBuffer->GetPhyAddr());
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock_);
+    return found;
+}
+
+int32_t BufferQueue::FlushBuffer(SurfaceBufferImpl& buffer, IpcIo* extraData)
 {
     pthread_mutex_lock(&lock_);
     SurfaceBufferImpl *tmpBuffer = GetBuffer(buffer);
@@ -170,11 +540,19 @@ int32_t BufferQueue::FlushBuffer(SurfaceBufferImpl& buffer)
         pthread_mutex_unlock(&lock_);
         return SURFACE_ERROR_BUFFER_NOT_EXISTED;
     }
-    dirtyList_.push_back(tmpBuffer);
     if (&buffer != tmpBuffer) {
-        tmpBuffer->CopyExtraData(buffer);
+        tmpBuffer->MoveExtraData(buffer);
     }
+    if (extraData != nullptr) {
+        int32_t ret = tmpBuffer->ReadExtraDataFromIpcIo(*extraData);
+        if (ret != SURFACE_ERROR_OK) {
+            pthread_mutex_unlock(&lock_);
+            return ret;
+        }
+    }
+    dirtyList_.push_back(tmpBuffer);
     tmpBuffer->SetState(BUFFER_STATE_FLUSH);
+    UpdateReadiness();
     pthread_mutex_unlock(&lock_);
     return 0;
 }
@@ -195,6 +573,7 @@ SurfaceBufferImpl* BufferQueue::AcquireBuffer()
     }
     buffer->SetState(BUFFER_STATE_ACQUIRE);
     dirtyList_.pop_front();
+    UpdateReadiness();
     pthread_mutex_unlock(&lock_);
     return buffer;
 }
@@ -208,9 +587,10 @@ void BufferQueue::Detach(SurfaceBufferImpl *buffer)
     freeList_.remove(buffer);
     dirtyList_.remove(buffer);
     allBuffers_.remove(buffer);
+    generation_++;
     BufferManager* bufferManager = BufferManager::GetInstance();
     if (bufferManager != nullptr) {
-        bufferManager->FreeBuffer(&buffer);
+        bufferManager->DeferFreeBuffer(buffer);
     }
 }
 
@@ -224,6 +604,94 @@ int32_t BufferQueue::CancelBuffer(const SurfaceBufferImpl& buffer)
     return ReleaseBuffer(buffer, BUFFER_STATE_REQUEST);
 }
 
+int32_t BufferQueue::DetachBuffer(const SurfaceBufferImpl& buffer)
+{
+    pthread_mutex_lock(&lock_);
+    SurfaceBufferImpl *tmpBuffer = GetBuffer(buffer);
+    if (tmpBuffer == nullptr ||
+        (tmpBuffer->GetState() != BUFFER_STATE_REQUEST && tmpBuffer->GetState() != BUFFER_STATE_ACQUIRE)) {
+        GRAPHIC_LOGI("Buffer is not existed or state invailed.");
+        pthread_mutex_unlock(&lock_);
+        return SURFACE_ERROR_BUFFER_NOT_EXISTED;
+    }
+    allBuffers_.remove(tmpBuffer);
+    tmpBuffer->SetBlobPool(nullptr);
+    tmpBuffer->SetState(BUFFER_STATE_NONE);
+    if (tmpBuffer->GetDeletePending() == 0) {
+        attachCount_--;
+    }
+    generation_++;
+    UpdateReadiness();
+    pthread_mutex_unlock(&lock_);
+    pthread_cond_signal(&freeCond_);
+    return SURFACE_ERROR_OK;
+}
+
+bool BufferQueue::IsAttachable(const SurfaceBufferImpl& buffer) const
+{
+    /* A delete pending buffer has stale attributes. */
+    if (buffer.GetDeletePending() == 1 || buffer.GetUsage() != usage_) {
+        return false;
+    }
+    /* Producers write the whole buffer of the queue attributes, a smaller one would be written past its end. */
+    if (customSize_) {
+        return buffer.GetMaxSize() >= size_;
+    }
+    uint32_t stride = static_cast<uint32_t>(buffer.GetStride());
+    if (buffer.GetWidth() != width_ || buffer.GetHeight() != height_ || buffer.GetFormat() != format_ ||
+        (stride_ != 0 && stride != stride_)) {
+        return false;
+    }
+    uint64_t size = size_;
+    if (size == 0) {
+        /* Nothing is allocated yet, expect the size of the attributes in rows of the buffer stride. */
+        if (stride < static_cast<uint64_t>(width_) * GetBytesPerPixel(format_)) {
+            return false;
+        }
+        size = GetPlanesSize(height_, format_, stride);
+    }
+    return buffer.GetMaxSize() >= size;
+}
+
+int32_t BufferQueue::AttachBuffer(SurfaceBufferImpl& buffer, bool dirty)
+{
+    pthread_mutex_lock(&lock_);
+    if (GetBuffer(buffer) != nullptr) {
+        GRAPHIC_LOGI("Buffer has been attached.");
+        pthread_mutex_unlock(&lock_);
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    /* Buffers in flight hold their slots too, an attach must not make the worker discard its allocation. */
+    if (attachCount_ + allocCount_ >= queueSize_) {
+        GRAPHIC_LOGI("has alloced %d buffer, could not attach more.", attachCount_ + allocCount_);
+        pthread_mutex_unlock(&lock_);
+        return SURFACE_ERROR_NOT_READY;
+    }
+    if (!IsAttachable(buffer)) {
+        GRAPHIC_LOGI("Buffer does not match the queue, size(%u) usage(%u) width(%u) height(%u) format(%u).",
+            buffer.GetMaxSize(), buffer.GetUsage(), buffer.GetWidth(), buffer.GetHeight(), buffer.GetFormat());
+        pthread_mutex_unlock(&lock_);
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    buffer.SetBlobPool(blobPool_);
+    attachCount_++;
+    AssignSlot(buffer);
+    allBuffers_.push_back(&buffer);
+    if (dirty) {
+        dirtyList_.push_back(&buffer);
+        buffer.SetState(BUFFER_STATE_FLUSH);
+    } else {
+        buffer.SetIdleTime(GetNowMs());
+        freeList_.push_back(&buffer);
+        buffer.SetState(BUFFER_STATE_RELEASE);
+        buffer.ClearExtraData();
+    }
+    UpdateReadiness();
+    pthread_mutex_unlock(&lock_);
+    pthread_cond_signal(&freeCond_);
+    return SURFACE_ERROR_OK;
+}
+
 int32_t BufferQueue::ReleaseBuffer(const SurfaceBufferImpl& buffer, BufferState state)
 {
     int32_t ret = 0;
@@ -250,10 +718,12 @@ int32_t BufferQueue::ReleaseBuffer(const SurfaceBufferImpl& buffer, BufferState
         goto ERROR;
     }
 
+    tmpBuffer->SetIdleTime(GetNowMs());
     freeList_.push_back(tmpBuffer);
     tmpBuffer->SetState(BUFFER_STATE_RELEASE);
     tmpBuffer->ClearExtraData();
 ERROR:
+    UpdateReadiness();
     pthread_mutex_unlock(&lock_);
     pthread_cond_signal(&freeCond_);
     return ret;
@@ -277,6 +747,7 @@ int32_t BufferQueue::Reset(uint32_t size)
         } else {
             size_ = 0;
             customSize_ = false;
+            attrGeneration_++;
         }
     }
     std::list<SurfaceBufferImpl *>::iterator iterBuffer = freeList_.begin();
@@ -289,7 +760,7 @@ int32_t BufferQueue::Reset(uint32_t size)
              ++iterBuffer;
             continue;
         }
-        bufferManager->FreeBuffer(&tmpBuffer);
+        bufferManager->DeferFreeBuffer(tmpBuffer);
         iterBuffer = freeList_.erase(iterBuffer);
     }
     for (iterBuffer = allBuffers_.begin(); iterBuffer != allBuffers_.end(); ++iterBuffer) {
@@ -297,6 +768,9 @@ int32_t BufferQueue::Reset(uint32_t size)
         tmpBuffer->SetDeletePending(1);
     }
     attachCount_ = 0;
+    resetGeneration_++;
+    generation_++;
+    UpdateReadiness();
     return 0;
 }
 
@@ -307,6 +781,7 @@ void BufferQueue::SetQueueSize(uint8_t queueSize)
         return;
     }
     pthread_mutex_lock(&lock_);
+    attrGeneration_++;
     if (queueSize_ > queueSize) {
         uint8_t needDelete = queueSize_ - queueSize;
         std::list<SurfaceBufferImpl *>::iterator iterBuffer = freeList_.begin();
@@ -319,18 +794,21 @@ void BufferQueue::SetQueueSize(uint8_t queueSize)
                 ++iterBuffer;
                 continue;
             }
-            bufferManager->FreeBuffer(&tmpBuffer);
+            bufferManager->DeferFreeBuffer(tmpBuffer);
             iterBuffer = freeList_.erase(iterBuffer);
             needDelete--;
             attachCount_--;
+            generation_++;
             if (needDelete == 0) {
                 break;
             }
         }
         queueSize_ = queueSize;
+        UpdateReadiness();
         pthread_mutex_unlock(&lock_);
     } else if (queueSize_ < queueSize) {
         queueSize_ = queueSize;
+        UpdateReadiness();
         pthread_mutex_unlock(&lock_);
         pthread_cond_signal(&freeCond_);
     }
@@ -346,6 +824,7 @@ void BufferQueue::SetWidthAndHeight(uint32_t width, uint32_t height)
     pthread_mutex_lock(&lock_);
     width_ = width;
     height_ = height;
+    attrGeneration_++;
     Reset();
     pthread_mutex_unlock(&lock_);
     pthread_cond_signal(&freeCond_);
@@ -366,6 +845,7 @@ void BufferQueue::SetSize(uint32_t size)
     pthread_mutex_lock(&lock_);
     size_ = size;
     customSize_ = true;
+    attrGeneration_++;
     Reset(size);
     pthread_mutex_unlock(&lock_);
     pthread_cond_signal(&freeCond_);
@@ -401,6 +881,7 @@ void BufferQueue::SetFormat(uint32_t format)
     }
     pthread_mutex_lock(&lock_);
     format_ = format;
+    attrGeneration_++;
     Reset();
     pthread_mutex_unlock(&lock_);
     pthread_cond_signal(&freeCond_);
@@ -415,6 +896,7 @@ void BufferQueue::SetStrideAlignment(uint32_t stride)
 {
     pthread_mutex_lock(&lock_);
     strideAlignment_ = stride;
+    attrGeneration_++;
     Reset();
     pthread_mutex_unlock(&lock_);
     pthread_cond_signal(&freeCond_);
@@ -434,6 +916,7 @@ void BufferQueue::SetUsage(uint32_t usage)
 {
     pthread_mutex_lock(&lock_);
     usage_ = usage;
+    attrGeneration_++;
     Reset();
     pthread_mutex_unlock(&lock_);
     pthread_cond_signal(&freeCond_);
@@ -38,4 +38,9 @@ bool BufferQueueConsumer::ReleaseBuffer(const SurfaceBufferImpl& buffer)
 {
     return bufferQueue_->ReleaseBuffer(buffer);
 }
+
+int32_t BufferQueueConsumer::GetAcquireEventFd()
+{
+    return bufferQueue_->GetDirtyEventFd();
+}
 } // end namespace OHOS
@@ -27,10 +27,57 @@ extern "C" {
 typedef int32_t (*IpcMsgHandle)(BufferQueueProducer* product, IpcIo *io, IpcIo *reply);
 };
 
+/*
+ * Replies of buffer requests carry the generations, so that remote producers find stale state without asking,
+ * and the error of one-way requests received since last reply.
+ */
+static uint32_t WriteGenerations(BufferQueueProducer* product, IpcIo *reply)
+{
+    uint32_t generation = product->GetGeneration();
+    WriteUint32(reply, generation);
+    WriteUint32(reply, product->GetConfigGeneration());
+    WriteInt32(reply, product->TakeAsyncError());
+    return generation;
+}
+
+/*
+ * Remote producers tell the slots mapped in their generation when requesting buffer. The requested buffer is
+ * referred by slot if it is mapped already, otherwise the whole buffer handle is sent.
+ */
+static void WriteRequestedBuffer(SurfaceBufferImpl& buffer, uint32_t generation, uint32_t knownGeneration,
+    uint32_t knownSlots, IpcIo *reply)
+{
+    uint32_t slot = buffer.GetSlot();
+    bool known = (slot < BUFFER_SLOT_MAX) && (knownGeneration == generation) && ((knownSlots & (1u << slot)) != 0);
+    WriteUint32(reply, slot);
+    WriteInt32(reply, buffer.GetKey());
+    WriteBool(reply, !known);
+    if (!known) {
+        buffer.WriteToIpcIo(*reply);
+    }
+}
+
+/* Buffers are referred by slot and key, or described in whole if the producer does not know the slot. */
+static int32_t ReadBufferRef(BufferQueueProducer* product, IpcIo *io, SurfaceBufferImpl& buffer)
+{
+    uint32_t slot = BUFFER_SLOT_INVALID;
+    int32_t key = 0;
+    ReadUint32(io, &slot);
+    ReadInt32(io, &key);
+    if (slot == BUFFER_SLOT_INVALID) {
+        return buffer.ReadAttrFromIpcIo(*io) ? SURFACE_ERROR_OK : SURFACE_ERROR_INVALID_PARAM;
+    }
+    return product->GetSlotBuffer(slot, key, buffer) ? SURFACE_ERROR_OK : SURFACE_ERROR_BUFFER_NOT_EXISTED;
+}
+
 static int32_t OnRequestBuffer(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
 {
-    uint8_t isWaiting;
+    uint8_t isWaiting = 0;
+    uint32_t knownGeneration = 0;
+    uint32_t knownSlots = 0;
     ReadUint8(io, &isWaiting);
+    ReadUint32(io, &knownGeneration);
+    ReadUint32(io, &knownSlots);
     SurfaceBufferImpl* buffer = product->RequestBuffer(isWaiting);
     uint32_t ret = -1;
     if (buffer == nullptr) {
@@ -39,7 +86,8 @@ static int32_t OnRequestBuffer(BufferQueueProducer* product, IpcIo *io, IpcIo *r
         ret = -1;
     } else {
         WriteInt32(reply, 0);
-        buffer->WriteToIpcIo(*reply);
+        uint32_t generation = WriteGenerations(product, reply);
+        WriteRequestedBuffer(*buffer, generation, knownGeneration, knownSlots, reply);
         ret = 0;
     }
     return ret;
@@ -48,24 +96,53 @@ static int32_t OnRequestBuffer(BufferQueueProducer* product, IpcIo *io, IpcIo *r
 static int32_t OnFlushBuffer(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
 {
     SurfaceBufferImpl buffer;
-    buffer.ReadFromIpcIo(*io);
-    WriteInt32(reply, product->EnqueueBuffer(buffer));
+    int32_t ret = ReadBufferRef(product, io, buffer);
+    if (ret == SURFACE_ERROR_OK) {
+        /* the extra data follows in io, decoded by buffer queue into its own buffer. */
+        ret = product->EnqueueBuffer(buffer, io);
+    }
+    WriteInt32(reply, ret);
+    WriteGenerations(product, reply);
     return 0;
 }
 
-static int32_t OnCancelBuffer(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
+/*
+ * Remote producers in async mode send FLUSH_BUFFER and CANCEL_BUFFER one-way. Nobody waits for the result,
+ * it is kept and reported with the generations of next reply.
+ */
+static int32_t OnOneWayMsg(BufferQueueProducer* product, uint32_t code, IpcIo *io)
 {
+    if ((code != FLUSH_BUFFER) && (code != CANCEL_BUFFER)) {
+        GRAPHIC_LOGW("One-way request code(%u) does not support.", code);
+        return SURFACE_ERROR_INVALID_REQUEST;
+    }
     SurfaceBufferImpl buffer;
-    buffer.ReadFromIpcIo(*io);
-    product->Cancel(&buffer);
-    WriteInt32(reply, 0);
-    return 0;
+    int32_t ret = ReadBufferRef(product, io, buffer);
+    if (ret != SURFACE_ERROR_OK) {
+        product->SetAsyncError(ret);
+        return ret;
+    }
+    if (code == CANCEL_BUFFER) {
+        product->Cancel(&buffer);
+        return SURFACE_ERROR_OK;
+    }
+    ret = product->EnqueueBuffer(buffer, io);
+    if (ret != SURFACE_ERROR_OK) {
+        /* the producer has dropped the buffer already, return it to free list. */
+        product->Cancel(&buffer);
+        product->SetAsyncError(ret);
+    }
+    return ret;
 }
 
-static int32_t OnGetAttr(uint32_t attr, IpcIo *io, IpcIo *reply)
+static int32_t OnCancelBuffer(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
 {
+    SurfaceBufferImpl buffer;
+    if (ReadBufferRef(product, io, buffer) == SURFACE_ERROR_OK) {
+        product->Cancel(&buffer);
+    }
     WriteInt32(reply, 0);
-    WriteUint32(reply, attr);
+    WriteGenerations(product, reply);
     return 0;
 }
 
@@ -83,11 +160,6 @@ static int32_t OnSetQueueSize(BufferQueueProducer* product, IpcIo *io, IpcIo *re
     return OnSendReply(io, reply);
 }
 
-static int32_t OnGetQueueSize(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
-{
-    return OnGetAttr(product->GetQueueSize(), io, reply);
-}
-
 static int32_t OnSetWidthAndHeight(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
 {
     uint32_t width;
@@ -98,16 +170,6 @@ static int32_t OnSetWidthAndHeight(BufferQueueProducer* product, IpcIo *io, IpcI
     return OnSendReply(io, reply);
 }
 
-static int32_t OnGetWidth(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
-{
-    return OnGetAttr(product->GetWidth(), io, reply);
-}
-
-static int32_t OnGetHeight(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
-{
-    return OnGetAttr(product->GetHeight(), io, reply);
-}
-
 static int32_t OnSetFormat(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
 {
     uint32_t format;
@@ -116,11 +178,6 @@ static int32_t OnSetFormat(BufferQueueProducer* product, IpcIo *io, IpcIo *reply
     return OnSendReply(io, reply);
 }
 
-static int32_t OnGetFormat(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
-{
-    return OnGetAttr(product->GetFormat(), io, reply);
-}
-
 static int32_t OnSetStrideAlignment(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
 {
     uint32_t strideAlignment;
@@ -129,16 +186,6 @@ static int32_t OnSetStrideAlignment(BufferQueueProducer* product, IpcIo *io, Ipc
     return OnSendReply(io, reply);
 }
 
-static int32_t GetStrideAlignment(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
-{
-    return OnGetAttr(product->GetStrideAlignment(), io, reply);
-}
-
-static int32_t OnGetStride(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
-{
-    return OnGetAttr(product->GetStride(), io, reply);
-}
-
 static int32_t OnSetSize(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
 {
     uint32_t size;
@@ -147,11 +194,6 @@ static int32_t OnSetSize(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
     return OnSendReply(io, reply);
 }
 
-static int32_t OnGetSize(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
-{
-    return OnGetAttr(product->GetSize(), io, reply);
-}
-
 static int32_t OnSetUsage(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
 {
     uint32_t usage;
@@ -160,11 +202,6 @@ static int32_t OnSetUsage(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
     return OnSendReply(io, reply);
 }
 
-static int32_t OnGetUsage(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
-{
-    return OnGetAttr(product->GetUsage(), io, reply);
-}
-
 static int32_t OnSetUserData(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
 {
     size_t len = 0;
@@ -199,32 +236,67 @@ static int32_t OnGetUserData(BufferQueueProducer* product, IpcIo *io, IpcIo *rep
     return 0;
 }
 
+static int32_t OnGetConfig(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
+{
+    BufferQueueConfig config = {0};
+    product->GetConfig(config);
+    WriteInt32(reply, 0);
+    WriteUint32(reply, sizeof(config));
+    WriteBuffer(reply, &config, sizeof(config));
+    return 0;
+}
+
+/* The buffer is flushed before next one is requested, so that a waiting request could get it back. */
+static int32_t OnFlushAndRequest(BufferQueueProducer* product, IpcIo *io, IpcIo *reply)
+{
+    uint8_t isWaiting = 0;
+    uint32_t knownGeneration = 0;
+    uint32_t knownSlots = 0;
+    ReadUint8(io, &isWaiting);
+    ReadUint32(io, &knownGeneration);
+    ReadUint32(io, &knownSlots);
+    SurfaceBufferImpl buffer;
+    int32_t ret = ReadBufferRef(product, io, buffer);
+    if (ret == SURFACE_ERROR_OK) {
+        ret = product->EnqueueBuffer(buffer, io);
+    }
+    SurfaceBufferImpl* next = (ret == SURFACE_ERROR_OK) ? product->RequestBuffer(isWaiting) : nullptr;
+    WriteInt32(reply, ret);
+    uint32_t generation = WriteGenerations(product, reply);
+    if (ret != SURFACE_ERROR_OK) {
+        return 0;
+    }
+    if (next == nullptr) {
+        WriteInt32(reply, -1);
+        return 0;
+    }
+    WriteInt32(reply, 0);
+    WriteRequestedBuffer(*next, generation, knownGeneration, knownSlots, reply);
+    return 0;
+}
+
 static IpcMsgHandle g_ipcMsgHandleList[] = {
     OnRequestBuffer,      // REQUEST_BUFFER
     OnFlushBuffer,        // FLUSH_BUFFER
     OnCancelBuffer,       // CANCEL_BUFFER
     OnSetQueueSize,       // SET_QUEUE_SIZE
-    OnGetQueueSize,       // GET_QUEUE_SIZE
     OnSetWidthAndHeight,  // SET_WIDTH_AND_HEIGHT
-    OnGetWidth,           // GET_WIDTH
-    OnGetHeight,          // GET_HEIGHT
     OnSetFormat,          // SET_FORMAT
-    OnGetFormat,          // GET_FORMAT
     OnSetStrideAlignment, // SET_STRIDE_ALIGNMENT
-    GetStrideAlignment,   // GET_STRIDE_ALIGNMENT
-    OnGetStride,          // GET_STRIDE
     OnSetSize,            // SET_SIZE
-    OnGetSize,            // GET_SIZE
     OnSetUsage,           // SET_USAGE
-    OnGetUsage,           // GET_USAGE
     OnSetUserData,        // SET_USER_DATA
     OnGetUserData,        // GET_USER_DATA
+    OnGetConfig,          // GET_CONFIG
+    OnFlushAndRequest,    // FLUSH_AND_REQUEST
 };
 
 BufferQueueProducer::BufferQueueProducer(BufferQueue* bufferQueue)
     : bufferQueue_(bufferQueue),
-      consumerListener_(nullptr)
+      consumerListener_(nullptr),
+      asyncError_(SURFACE_ERROR_OK)
 {
+    pthread_mutex_init(&lock_, nullptr);
 }
 BufferQueueProducer::~BufferQueueProducer()
 {
@@ -233,6 +305,7 @@ BufferQueueProducer::~BufferQueueProducer()
         delete bufferQueue_;
         bufferQueue_ = nullptr;
     }
+    pthread_mutex_destroy(&lock_);
 }
 
 SurfaceBufferImpl* BufferQueueProducer::RequestBuffer(uint8_t wait)
@@ -242,10 +315,10 @@ SurfaceBufferImpl* BufferQueueProducer::RequestBuffer(uint8_t wait)
     return buffer;
 }
 
-int32_t BufferQueueProducer::EnqueueBuffer(SurfaceBufferImpl& buffer)
+int32_t BufferQueueProducer::EnqueueBuffer(SurfaceBufferImpl& buffer, IpcIo* extraData)
 {
     RETURN_VAL_IF_FAIL(bufferQueue_, SURFACE_ERROR_INVALID_PARAM);
-    int32_t ret = bufferQueue_->FlushBuffer(buffer);
+    int32_t ret = bufferQueue_->FlushBuffer(buffer, extraData);
     if (ret == 0) {
         if (consumerListener_ != nullptr) {
             consumerListener_->OnBufferAvailable();
@@ -260,14 +333,24 @@ int32_t BufferQueueProducer::FlushBuffer(SurfaceBufferImpl* buffer)
     RETURN_VAL_IF_FAIL(bufferQueue_, SURFACE_ERROR_INVALID_PARAM);
     BufferManager* manager = BufferManager::GetInstance();
     RETURN_VAL_IF_FAIL(manager, SURFACE_ERROR_NOT_READY);
-    if (buffer->GetUsage() == BUFFER_CONSUMER_USAGE_HARDWARE_CONSUMER_CACHE) {
+    if (buffer->GetUsage() == BUFFER_CONSUMER_USAGE_HARDWARE_CONSUMER_CACHE && !buffer->IsCpuCacheFlushed()) {
         int32_t ret = manager->FlushCache(*buffer);
         if (ret != 0) {
             GRAPHIC_LOGW("Flush buffer failed, ret=%d", ret);
             return ret;
         }
     }
-    return EnqueueBuffer(*buffer);
+    return EnqueueBuffer(*buffer, nullptr);
+}
+
+int32_t BufferQueueProducer::FlushAndRequestBuffer(SurfaceBufferImpl* buffer, SurfaceBufferImpl*& next, uint8_t wait)
+{
+    next = nullptr;
+    int32_t ret = FlushBuffer(buffer);
+    if (ret == SURFACE_ERROR_OK) {
+        next = RequestBuffer(wait);
+    }
+    return ret;
 }
 
 void BufferQueueProducer::Cancel(SurfaceBufferImpl* buffer)
@@ -276,6 +359,91 @@ void BufferQueueProducer::Cancel(SurfaceBufferImpl* buffer)
     bufferQueue_->CancelBuffer(*buffer);
 }
 
+int32_t BufferQueueProducer::DetachBuffer(SurfaceBufferImpl& buffer)
+{
+    RETURN_VAL_IF_FAIL(bufferQueue_, SURFACE_ERROR_INVALID_PARAM);
+    return bufferQueue_->DetachBuffer(buffer);
+}
+
+int32_t BufferQueueProducer::AttachBuffer(SurfaceBufferImpl& buffer, bool dirty)
+{
+    RETURN_VAL_IF_FAIL(bufferQueue_, SURFACE_ERROR_INVALID_PARAM);
+    int32_t ret = bufferQueue_->AttachBuffer(buffer, dirty);
+    if (ret == SURFACE_ERROR_OK && dirty) {
+        if (consumerListener_ != nullptr) {
+            consumerListener_->OnBufferAvailable();
+        }
+    }
+    return ret;
+}
+
+int32_t BufferQueueProducer::GetRequestEventFd()
+{
+    RETURN_VAL_IF_FAIL(bufferQueue_, -1);
+    return bufferQueue_->GetFreeEventFd();
+}
+
+uint32_t BufferQueueProducer::GetGeneration()
+{
+    RETURN_VAL_IF_FAIL(bufferQueue_, 0);
+    return bufferQueue_->GetGeneration();
+}
+
+uint32_t BufferQueueProducer::GetConfigGeneration()
+{
+    RETURN_VAL_IF_FAIL(bufferQueue_, 0);
+    return bufferQueue_->GetConfigGeneration();
+}
+
+void BufferQueueProducer::GetConfig(BufferQueueConfig& config)
+{
+    RETURN_IF_FAIL(bufferQueue_);
+    bufferQueue_->GetConfig(config);
+}
+
+bool BufferQueueProducer::GetSlotBuffer(uint32_t slot, int32_t key, SurfaceBufferImpl& buffer)
+{
+    RETURN_VAL_IF_FAIL(bufferQueue_, false);
+    return bufferQueue_->GetSlotBuffer(slot, key, buffer);
+}
+
+void BufferQueueProducer::SetAsyncError(int32_t error)
+{
+    pthread_mutex_lock(&lock_);
+    /* the first error is kept, later ones are usually caused by it. */
+    if (asyncError_ == SURFACE_ERROR_OK) {
+        asyncError_ = error;
+    }
+    pthread_mutex_unlock(&lock_);
+}
+
+int32_t BufferQueueProducer::TakeAsyncError()
+{
+    pthread_mutex_lock(&lock_);
+    int32_t error = asyncError_;
+    asyncError_ = SURFACE_ERROR_OK;
+    pthread_mutex_unlock(&lock_);
+    return error;
+}
+
+int32_t BufferQueueProducer::SetIdlePolicy(uint32_t timeout, uint8_t floor)
+{
+    RETURN_VAL_IF_FAIL(bufferQueue_, SURFACE_ERROR_INVALID_PARAM);
+    return bufferQueue_->SetIdlePolicy(timeout, floor);
+}
+
+int32_t BufferQueueProducer::SetAllocFlags(uint32_t flags)
+{
+    RETURN_VAL_IF_FAIL(bufferQueue_, SURFACE_ERROR_INVALID_PARAM);
+    return bufferQueue_->SetAllocFlags(flags);
+}
+
+uint32_t BufferQueueProducer::GetAllocFlags()
+{
+    RETURN_VAL_IF_FAIL(bufferQueue_, BUFFER_ALLOC_FLAG_NONE);
+    return bufferQueue_->GetAllocFlags();
+}
+
 void BufferQueueProducer::SetQueueSize(uint8_t queueSize)
 {
     RETURN_IF_FAIL(bufferQueue_);
@@ -381,6 +549,10 @@ int32_t BufferQueueProducer::OnIpcMsg(uint32_t code, IpcIo *data, IpcIo *reply,
         GRAPHIC_LOGW("Resquest code(%u) does not support.", code);
         return SURFACE_ERROR_INVALID_REQUEST;
     }
+    /* Other bits could be set by the ipc layer, a one-way message has no reply whatever they are. */
+    if ((option.flags & TF_OP_ASYNC) != 0) {
+        return OnOneWayMsg(this, code, data);
+    }
     return g_ipcMsgHandleList[code](this, data, reply);
 }
 
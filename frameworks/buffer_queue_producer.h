@@ -16,6 +16,7 @@
 #ifndef GRAPHIC_LITE_BUFFER_QUEUEU_PRODUCER_H
 #define GRAPHIC_LITE_BUFFER_QUEUEU_PRODUCER_H
 
+#include <pthread.h>
 #include "buffer_producer.h"
 #include "buffer_queue.h"
 #include "ibuffer_consumer_listener.h"
@@ -60,13 +61,24 @@ public:
      */
     int32_t FlushBuffer(SurfaceBufferImpl* buffer) override;
 
+    /**
+     * @brief Flush buffer and request next buffer at once.
+     * @param [in] SurfaceBufferImpl pointer, Which buffer could acquire for consumer.
+     * @param [out] next, the requested buffer, nullptr if flush failed or no buffer could be requested.
+     * @param [in] whether waiting or not for next buffer.
+     * @returns Flush buffer succeed or not.
+     *        0 is succeed; other is failed.
+     */
+    int32_t FlushAndRequestBuffer(SurfaceBufferImpl* buffer, SurfaceBufferImpl*& next, uint8_t wait) override;
+
     /**
      * @brief Enqueue buffer for consumer acquire and notice consumer to acquire it.
      * @param [in] SurfaceBufferImpl, Which buffer could acquire for consumer.
+     * @param [in] IpcIo pointer, extra data to decode into the buffer in queue, null if in the input buffer.
      * @returns Enqueue buffer succeed or not.
      *        0 is succeed; other is failed.
      */
-    int32_t EnqueueBuffer(SurfaceBufferImpl& buffer);
+    int32_t EnqueueBuffer(SurfaceBufferImpl& buffer, IpcIo* extraData);
 
     /**
      * @brief Cancel buffer. Producer cancel this buffer, buffer will push to free list for request it.
@@ -74,6 +86,87 @@ public:
      */
     void Cancel(SurfaceBufferImpl* buffer) override;
 
+    /**
+     * @brief Detach buffer from the buffer queue, the buffer is not freed and could be attached to other queue.
+     * @param [in] SurfaceBufferImpl, Which buffer need to detach.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t DetachBuffer(SurfaceBufferImpl& buffer);
+
+    /**
+     * @brief Attach buffer detached from other queue. If dirty, notice consumer to acquire it.
+     * @param [in] SurfaceBufferImpl, Which buffer need to attach.
+     * @param [in] dirty, push to dirty list if true, otherwise push to free list.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t AttachBuffer(SurfaceBufferImpl& buffer, bool dirty);
+
+    /**
+     * @brief Get the event fd which is readable when some buffer could be requested without waiting.
+     * @returns The event fd, -1 if failed.
+     */
+    int32_t GetRequestEventFd();
+
+    /**
+     * @brief Get the buffer generation, see BufferQueue::GetGeneration.
+     * @returns The buffer generation.
+     */
+    uint32_t GetGeneration();
+
+    /**
+     * @brief Get the config generation, see BufferQueue::GetConfigGeneration.
+     * @returns The config generation.
+     */
+    uint32_t GetConfigGeneration();
+
+    /**
+     * @brief Get all attributes at once, see BufferQueue::GetConfig.
+     * @param [out] config, the attributes and the config generation.
+     */
+    void GetConfig(BufferQueueConfig& config);
+
+    /**
+     * @brief Find the buffer attached in slot, see BufferQueue::GetSlotBuffer.
+     * @param [in] slot, the slot of buffer.
+     * @param [in] key, the key of buffer, to verify the buffer in slot.
+     * @param [out] buffer, the buffer which is identified as the buffer in slot.
+     * @returns Whether the buffer is found or not.
+     */
+    bool GetSlotBuffer(uint32_t slot, int32_t key, SurfaceBufferImpl& buffer);
+
+    /**
+     * @brief Keep the error of a one-way request, to report it with next reply to the remote producer.
+     * @param [in] error, the error code. Only the first error is kept until it is taken.
+     */
+    void SetAsyncError(int32_t error);
+
+    /**
+     * @brief Take the error of one-way requests kept since last call.
+     * @returns The error code, SURFACE_ERROR_OK if no one-way request failed.
+     */
+    int32_t TakeAsyncError();
+
+    /**
+     * @brief Set idle policy, see BufferQueue::SetIdlePolicy.
+     * @param [in] timeout, idle time in milliseconds, 0 is disable.
+     * @param [in] floor, min buffer count to keep.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t SetIdlePolicy(uint32_t timeout, uint8_t floor);
+
+    /**
+     * @brief Set allocation flags, see BufferQueue::SetAllocFlags.
+     * @param [in] flags, combination of BufferAllocFlag.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t SetAllocFlags(uint32_t flags);
+
+    /**
+     * @brief Get allocation flags.
+     * @returns combination of BufferAllocFlag.
+     */
+    uint32_t GetAllocFlags();
+
     /**
      * @brief Set queue size, the surface could alloc max buffer count.
      *        Default is 1. Max count is 10.
@@ -202,6 +295,8 @@ public:
 private:
     BufferQueue* bufferQueue_;
     IBufferConsumerListener* consumerListener_;
+    pthread_mutex_t lock_;
+    int32_t asyncError_; /* error of one-way requests, reported with next reply */
 };
 } // end namespace
 #endif
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "buffer_worker.h"
+
+#include <time.h>
+#include "buffer_common.h"
+
+namespace OHOS {
+const int64_t MSEC_PER_SEC = 1000;
+const int64_t NSEC_PER_MSEC = 1000000;
+
+BufferWorker* BufferWorker::GetInstance()
+{
+    /* Never destroyed, the thread may still run when static objects are destroyed at exit. */
+    static BufferWorker* instance = new BufferWorker();
+    return instance;
+}
+
+BufferWorker::BufferWorker() : started_(false), thread_(0), runningOwner_(nullptr)
+{
+    pthread_mutex_init(&lock_, nullptr);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&workCond_, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&doneCond_, nullptr);
+}
+
+int64_t BufferWorker::GetNowMs()
+{
+    struct timespec now = {0};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * MSEC_PER_SEC + now.tv_nsec / NSEC_PER_MSEC;
+}
+
+void* BufferWorker::ThreadMain(void* arg)
+{
+    static_cast<BufferWorker*>(arg)->Run();
+    return nullptr;
+}
+
+void BufferWorker::Run()
+{
+    pthread_mutex_lock(&lock_);
+    while (true) {
+        if (works_.empty()) {
+            pthread_cond_wait(&workCond_, &lock_);
+            continue;
+        }
+        std::list<BufferWork>::iterator next = works_.begin();
+        std::list<BufferWork>::iterator iter;
+        for (iter = works_.begin(); iter != works_.end(); ++iter) {
+            if (iter->runTime < next->runTime) {
+                next = iter;
+            }
+        }
+        if (next->runTime > GetNowMs()) {
+            struct timespec deadline = {0};
+            deadline.tv_sec = next->runTime / MSEC_PER_SEC;
+            deadline.tv_nsec = (next->runTime % MSEC_PER_SEC) * NSEC_PER_MSEC;
+            pthread_cond_timedwait(&workCond_, &lock_, &deadline);
+            continue;
+        }
+        BufferWork work = *next;
+        works_.erase(next);
+        runningOwner_ = work.owner;
+        pthread_mutex_unlock(&lock_);
+        work.func(work.owner);
+        pthread_mutex_lock(&lock_);
+        runningOwner_ = nullptr;
+        pthread_cond_broadcast(&doneCond_);
+    }
+    pthread_mutex_unlock(&lock_);
+}
+
+bool BufferWorker::Post(void* owner, BufferWorkFunc func)
+{
+    return PostDelayed(owner, func, 0);
+}
+
+bool BufferWorker::PostDelayed(void* owner, BufferWorkFunc func, uint32_t delay)
+{
+    RETURN_VAL_IF_FAIL(func, false);
+    pthread_mutex_lock(&lock_);
+    if (!started_) {
+        if (pthread_create(&thread_, nullptr, ThreadMain, this) != 0) {
+            GRAPHIC_LOGE("Create buffer worker thread failed.");
+            pthread_mutex_unlock(&lock_);
+            return false;
+        }
+        pthread_detach(thread_);
+        started_ = true;
+    }
+    int64_t runTime = GetNowMs() + delay;
+    std::list<BufferWork>::iterator iter;
+    for (iter = works_.begin(); iter != works_.end(); ++iter) {
+        if (iter->owner == owner && iter->func == func) {
+            iter->runTime = (runTime < iter->runTime) ? runTime : iter->runTime;
+            pthread_cond_signal(&workCond_);
+            pthread_mutex_unlock(&lock_);
+            return true;
+        }
+    }
+    BufferWork work = {owner, func, runTime};
+    works_.push_back(work);
+    pthread_cond_signal(&workCond_);
+    pthread_mutex_unlock(&lock_);
+    return true;
+}
+
+void BufferWorker::RemoveWorks(void* owner)
+{
+    std::list<BufferWork>::iterator iter = works_.begin();
+    while (iter != works_.end()) {
+        if (iter->owner == owner) {
+            iter = works_.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+}
+
+void BufferWorker::Cancel(void* owner)
+{
+    pthread_mutex_lock(&lock_);
+    RemoveWorks(owner);
+    while (started_ && runningOwner_ == owner && !pthread_equal(pthread_self(), thread_)) {
+        pthread_cond_wait(&doneCond_, &lock_);
+    }
+    /* The running work may have posted work again, like a periodic work re-posting itself. */
+    RemoveWorks(owner);
+    pthread_mutex_unlock(&lock_);
+}
+} // end namespace
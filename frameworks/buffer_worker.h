@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GRAPHIC_LITE_BUFFER_WORKER_H
+#define GRAPHIC_LITE_BUFFER_WORKER_H
+
+#include <cstdint>
+#include <list>
+#include <pthread.h>
+
+namespace OHOS {
+typedef void (*BufferWorkFunc)(void* owner);
+
+/**
+ * @brief Buffer worker. A process-wide background thread running slow buffer work, like allocating buffers
+ *        from gralloc, out of the request and release path of buffer queues.
+ */
+class BufferWorker {
+public:
+    /**
+     * @brief Buffer worker single instance. The thread is started by the first posted work.
+     * @returns BufferWorker pointer.
+     */
+    static BufferWorker* GetInstance();
+
+    /**
+     * @brief Post work to the worker thread. The same work of the same owner is queued only once.
+     * @param [in] owner, passed to the work function.
+     * @param [in] func, work function.
+     * @returns Whether post succeed or not.
+     */
+    bool Post(void* owner, BufferWorkFunc func);
+
+    /**
+     * @brief Post work to run after a delay. The same work of the same owner is queued only once, a queued
+     *        work keeps its earlier run time.
+     * @param [in] owner, passed to the work function.
+     * @param [in] func, work function.
+     * @param [in] delay, delay time in milliseconds.
+     * @returns Whether post succeed or not.
+     */
+    bool PostDelayed(void* owner, BufferWorkFunc func, uint32_t delay);
+
+    /**
+     * @brief Remove all queued work of the owner, and wait for its running work to finish. Work posted by
+     *        the running work meanwhile is removed too.
+     *        Must not be called with a lock which the work function takes.
+     * @param [in] owner, the work owner.
+     */
+    void Cancel(void* owner);
+
+private:
+    BufferWorker();
+    ~BufferWorker() {}
+    static void* ThreadMain(void* arg);
+    static int64_t GetNowMs();
+    void Run();
+    void RemoveWorks(void* owner);
+
+    struct BufferWork {
+        void* owner;
+        BufferWorkFunc func;
+        int64_t runTime; /* monotonic time in milliseconds */
+    };
+    bool started_;
+    pthread_t thread_;
+    pthread_mutex_t lock_;
+    pthread_cond_t workCond_;
+    pthread_cond_t doneCond_;
+    std::list<BufferWork> works_;
+    void* runningOwner_;
+};
+} // end namespace
+#endif
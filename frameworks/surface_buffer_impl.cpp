@@ -14,15 +14,89 @@
  */
 
 #include "surface_buffer_impl.h"
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
+#include "buffer_blob_pool.h"
+#include "buffer_manager.h"
 #include "securec.h"
 
 namespace OHOS {
 const uint16_t MAX_USER_DATA_COUNT = 1000;
+const uint32_t BUFFER_WIRE_VERSION = 1;
 
-SurfaceBufferImpl::SurfaceBufferImpl() : len_(0)
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+#error "Buffer wire data is little endian."
+#endif
+
+/* Buffer attr sent across processes in one block. Fields are added at the end with a new version. */
+struct BufferWireData {
+    uint32_t version;
+    int32_t key;
+    uint64_t phyAddr;
+    int32_t stride;
+    uint32_t size;
+    uint32_t usage;
+    uint32_t len;
+    uint32_t reserveFds;
+    uint32_t reserveInts;
+    uint32_t planeCount;
+    uint32_t padding;
+    PlaneInfo planes[SURFACE_MAX_PLANE_NUM];
+    int32_t reserve[BUFFER_RESERVE_MAX_NUM];
+};
+
+SurfaceBufferImpl::SurfaceBufferImpl()
+    : inlineCount_(0), blobPool_(nullptr), blobCount_(0), ipcBaseline_(nullptr), ipcVersion_(0), len_(0),
+      cpuAccessOffset_(0), cpuAccessLength_(0), cpuAccessMode_(0), cpuCacheFlushed_(false), idleTime_(0),
+      slot_(BUFFER_SLOT_INVALID), planeCount_(0)
 {
-    struct SurfaceBufferData bufferData = {{0}, 0, 0, 0, BUFFER_STATE_NONE, NULL};
+    struct SurfaceBufferData bufferData = {{0}, 0, 0, 0, 0, IMAGE_PIXEL_FORMAT_NONE, 0, BUFFER_STATE_NONE, NULL};
     bufferData_ = bufferData;
+    (void)memset_s(planes_, sizeof(planes_), 0, sizeof(planes_));
+    (void)memset_s(reserve_, sizeof(reserve_), 0, sizeof(reserve_));
+    (void)memset_s(&frameMetadata_, sizeof(frameMetadata_), 0, sizeof(frameMetadata_));
+}
+
+int32_t SurfaceBufferImpl::SetReserve(const int32_t* reserve, uint32_t reserveFds, uint32_t reserveInts)
+{
+    if ((reserveFds > BUFFER_RESERVE_MAX_NUM) || (reserveInts > BUFFER_RESERVE_MAX_NUM - reserveFds) ||
+        (reserveFds + reserveInts > 0 && reserve == nullptr)) {
+        GRAPHIC_LOGW("Unsupported reserve fds %u ints %u.", reserveFds, reserveInts);
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    for (uint32_t i = 0; i < reserveFds + reserveInts; i++) {
+        reserve_[i] = reserve[i];
+    }
+    bufferData_.handle.reserveFds = reserveFds;
+    bufferData_.handle.reserveInts = reserveInts;
+    return SURFACE_ERROR_OK;
+}
+
+int32_t SurfaceBufferImpl::GetPlane(uint8_t index, PlaneInfo& plane) const
+{
+    if (index >= planeCount_) {
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    plane = planes_[index];
+    return SURFACE_ERROR_OK;
+}
+
+int32_t SurfaceBufferImpl::SetPlanes(const PlaneInfo* planes, uint8_t count)
+{
+    if ((count > SURFACE_MAX_PLANE_NUM) || (count > 0 && planes == nullptr)) {
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        planes_[i] = planes[i];
+    }
+    planeCount_ = count;
+    return SURFACE_ERROR_OK;
+}
+
+void SurfaceBufferImpl::CopyPlanes(const SurfaceBufferImpl& buffer)
+{
+    SetPlanes(buffer.planes_, buffer.planeCount_);
 }
 
 int32_t SurfaceBufferImpl::SetInt32(uint32_t key, int32_t value)
@@ -34,7 +108,7 @@ int32_t SurfaceBufferImpl::GetInt32(uint32_t key, int32_t& value)
 {
     uint8_t type = BUFFER_DATA_TYPE_NONE;
     void *data = nullptr;
-    uint8_t size;
+    uint32_t size;
     if (GetData(key, &type, &data, &size) != SURFACE_ERROR_OK || type != BUFFER_DATA_TYPE_INT_32) {
         return SURFACE_ERROR_INVALID_PARAM;
     }
@@ -54,7 +128,7 @@ int32_t SurfaceBufferImpl::GetInt64(uint32_t key, int64_t& value)
 {
     uint8_t type = BUFFER_DATA_TYPE_NONE;
     void *data = nullptr;
-    uint8_t size;
+    uint32_t size;
     if (GetData(key, &type, &data, &size) != SURFACE_ERROR_OK || type != BUFFER_DATA_TYPE_INT_64) {
         return SURFACE_ERROR_INVALID_PARAM;
     }
@@ -65,73 +139,278 @@ int32_t SurfaceBufferImpl::GetInt64(uint32_t key, int64_t& value)
     return SURFACE_ERROR_OK;
 }
 
-int32_t SurfaceBufferImpl::SetData(uint32_t key, uint8_t type, const void* data, uint8_t size)
+int32_t SurfaceBufferImpl::SetBlob(uint32_t key, const void* data, uint32_t size)
 {
-    if (type <= BUFFER_DATA_TYPE_NONE ||
-        type >= BUFFER_DATA_TYPE_MAX ||
-        size <= 0 ||
-        size > sizeof(int64_t)) {
+    if (data == nullptr) {
         GRAPHIC_LOGI("Invalid Param");
         return SURFACE_ERROR_INVALID_PARAM;
     }
-    if (extDatas_.size() > MAX_USER_DATA_COUNT) {
-        GRAPHIC_LOGI("No more data can be saved because the storage space is full.");
+    void* blob = ReserveBlob(key, size);
+    if (blob == nullptr) {
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    if (memcpy_s(blob, size, data, size) != EOK) {
+        GRAPHIC_LOGW("Couldn't copy %u bytes for blob", size);
         return SURFACE_ERROR_SYSTEM_ERROR;
     }
-    ExtraData extData = {0};
-    std::map<uint32_t, ExtraData>::iterator iter = extDatas_.find(key);
-    if (iter != extDatas_.end()) {
-        extData = iter->second;
-        if (size != extData.size) {
-            free(extData.value);
-            extData.value = nullptr;
+    return SURFACE_ERROR_OK;
+}
+
+int32_t SurfaceBufferImpl::GetBlob(uint32_t key, const void*& data, uint32_t& size)
+{
+    uint8_t type = BUFFER_DATA_TYPE_NONE;
+    void *blob = nullptr;
+    uint32_t blobSize;
+    if (GetData(key, &type, &blob, &blobSize) != SURFACE_ERROR_OK || type != BUFFER_DATA_TYPE_BLOB) {
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    data = blob;
+    size = blobSize;
+    return SURFACE_ERROR_OK;
+}
+
+void* SurfaceBufferImpl::ReserveBlob(uint32_t key, uint32_t size)
+{
+    if (size == 0 || size > SURFACE_MAX_BLOB_SIZE) {
+        GRAPHIC_LOGI("Invalid blob size %u", size);
+        return nullptr;
+    }
+    ExtraData* extData = FindData(key);
+    if (extData != nullptr && extData->type == BUFFER_DATA_TYPE_BLOB &&
+        BlobPool::GetCapacity(extData->value.blob) >= size) {
+        BlobPool::Invalidate(extData->value.blob);
+        extData->size = size;
+        return extData->value.blob;
+    }
+    if (extData == nullptr && GetExtraDataCount() > MAX_USER_DATA_COUNT) {
+        GRAPHIC_LOGI("No more data can be saved because the storage space is full.");
+        return nullptr;
+    }
+    void* blob = BlobPool::Alloc(blobPool_, size);
+    if (blob == nullptr) {
+        return nullptr;
+    }
+    if (extData == nullptr) {
+        extData = InsertData(key);
+    } else if (extData->type == BUFFER_DATA_TYPE_BLOB) {
+        BlobPool::Free(extData->value.blob);
+        blobCount_--;
+    }
+    extData->type = BUFFER_DATA_TYPE_BLOB;
+    extData->size = size;
+    extData->value.blob = blob;
+    blobCount_++;
+    return blob;
+}
+
+int32_t SurfaceBufferImpl::SetFrameMetadata(const FrameMetadata& metadata)
+{
+    uint32_t fields = metadata.fields;
+    if (((fields & ~FRAME_METADATA_MASK) != 0) ||
+        ((fields & FRAME_METADATA_TRANSFORM) && (metadata.transform >= FRAME_TRANSFORM_MAX)) ||
+        ((fields & FRAME_METADATA_COLOR) &&
+        ((metadata.colorSpace >= FRAME_COLOR_SPACE_MAX) || (metadata.colorRange >= FRAME_COLOR_RANGE_MAX))) ||
+        ((fields & FRAME_METADATA_HDR) && (metadata.hdr.transfer >= FRAME_HDR_TRANSFER_MAX))) {
+        GRAPHIC_LOGI("Invalid Param");
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    frameMetadata_ = metadata;
+    return SURFACE_ERROR_OK;
+}
+
+static bool IsCachedUsage(uint32_t usage)
+{
+    return (usage == BUFFER_CONSUMER_USAGE_HARDWARE_CONSUMER_CACHE) ||
+        (usage == BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE);
+}
+
+int32_t SurfaceBufferImpl::BeginCpuAccess(uint32_t offset, uint32_t length, uint32_t mode)
+{
+    if ((mode == 0) || ((mode & ~CPU_ACCESS_READ_WRITE) != 0) || (length == 0) ||
+        (offset > bufferData_.size) || (length > bufferData_.size - offset)) {
+        GRAPHIC_LOGI("Invalid Param");
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    if (cpuAccessMode_ != 0) {
+        GRAPHIC_LOGI("Cpu access is in progress.");
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    if ((mode & CPU_ACCESS_READ) && IsCachedUsage(bufferData_.usage)) {
+        BufferManager* manager = BufferManager::GetInstance();
+        RETURN_VAL_IF_FAIL(manager, SURFACE_ERROR_NOT_READY);
+        int32_t ret = manager->InvalidateCache(*this, offset, length);
+        if (ret != SURFACE_ERROR_OK) {
+            return ret;
         }
     }
-    if (extData.value == nullptr) {
-        extData.value = malloc(size);
-        if (extData.value == nullptr) {
-            GRAPHIC_LOGE("Couldn't allocate %zu bytes for ext data", size);
+    if (mode & CPU_ACCESS_WRITE) {
+        cpuCacheFlushed_ = false;
+    }
+    cpuAccessOffset_ = offset;
+    cpuAccessLength_ = length;
+    cpuAccessMode_ = mode;
+    return SURFACE_ERROR_OK;
+}
+
+int32_t SurfaceBufferImpl::EndCpuAccess()
+{
+    if (cpuAccessMode_ == 0) {
+        GRAPHIC_LOGI("No cpu access is in progress.");
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    uint32_t mode = cpuAccessMode_;
+    cpuAccessMode_ = 0;
+    if ((mode & CPU_ACCESS_WRITE) && IsCachedUsage(bufferData_.usage)) {
+        BufferManager* manager = BufferManager::GetInstance();
+        RETURN_VAL_IF_FAIL(manager, SURFACE_ERROR_NOT_READY);
+        int32_t ret = manager->FlushCache(*this, cpuAccessOffset_, cpuAccessLength_);
+        if (ret != SURFACE_ERROR_OK) {
+            return ret;
+        }
+    }
+    if (mode & CPU_ACCESS_WRITE) {
+        cpuCacheFlushed_ = true;
+    }
+    return SURFACE_ERROR_OK;
+}
+
+int32_t SurfaceBufferImpl::SetData(uint32_t key, uint8_t type, const void* data, uint32_t size)
+{
+    if (type <= BUFFER_DATA_TYPE_NONE ||
+        type >= BUFFER_DATA_TYPE_BLOB ||
+        size <= 0 ||
+        size > sizeof(int64_t)) {
+        GRAPHIC_LOGI("Invalid Param");
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    ExtraData* extData = FindData(key);
+    if (extData == nullptr) {
+        if (GetExtraDataCount() > MAX_USER_DATA_COUNT) {
+            GRAPHIC_LOGI("No more data can be saved because the storage space is full.");
             return SURFACE_ERROR_SYSTEM_ERROR;
         }
+        extData = InsertData(key);
+    } else if (extData->type == BUFFER_DATA_TYPE_BLOB) {
+        BlobPool::Free(extData->value.blob);
+        blobCount_--;
     }
-    if (memcpy_s(extData.value, size, data, size) != EOK) {
-        free(extData.value);
-        GRAPHIC_LOGW("Couldn't copy %zu bytes for ext data", size);
+    if (memcpy_s(extData->value.bytes, sizeof(extData->value.bytes), data, size) != EOK) {
+        GRAPHIC_LOGW("Couldn't copy %u bytes for ext data", size);
         return SURFACE_ERROR_SYSTEM_ERROR;
     }
-    extData.size = size;
-    extData.type = type;
-    extDatas_[key] = extData;
+    extData->size = size;
+    extData->type = type;
     return SURFACE_ERROR_OK;
 }
 
-int32_t SurfaceBufferImpl::GetData(uint32_t key, uint8_t* type, void** data, uint8_t* size)
+static bool CompareExtraDataKey(const ExtraData& extData, uint32_t key)
+{
+    return extData.key < key;
+}
+
+ExtraData* SurfaceBufferImpl::FindData(uint32_t key)
+{
+    ExtraData* end = inlineDatas_ + inlineCount_;
+    ExtraData* extData = std::lower_bound(inlineDatas_, end, key, CompareExtraDataKey);
+    if (extData != end && extData->key == key) {
+        return extData;
+    }
+    if (extDatas_.empty()) {
+        return nullptr;
+    }
+    std::map<uint32_t, ExtraData>::iterator iter = extDatas_.find(key);
+    if (iter == extDatas_.end()) {
+        return nullptr;
+    }
+    return &(iter->second);
+}
+
+ExtraData* SurfaceBufferImpl::InsertData(uint32_t key)
+{
+    if (inlineCount_ >= EXTRA_DATA_INLINE_NUM) {
+        ExtraData& extData = extDatas_[key];
+        extData.key = key;
+        return &extData;
+    }
+    ExtraData* end = inlineDatas_ + inlineCount_;
+    ExtraData* extData = std::lower_bound(inlineDatas_, end, key, CompareExtraDataKey);
+    size_t moveSize = (end - extData) * sizeof(ExtraData);
+    if (moveSize > 0) {
+        (void)memmove_s(extData + 1, moveSize, extData, moveSize);
+    }
+    inlineCount_++;
+    extData->key = key;
+    return extData;
+}
+
+int32_t SurfaceBufferImpl::GetData(uint32_t key, uint8_t* type, void** data, uint32_t* size)
 {
     if ((type == nullptr) || (data == nullptr) || (size == nullptr)) {
         return SURFACE_ERROR_INVALID_PARAM;
     }
 
-    std::map<uint32_t, ExtraData>::iterator iter = extDatas_.find(key);
-    if (iter == extDatas_.end()) {
+    ExtraData* extData = FindData(key);
+    if (extData == nullptr) {
         return SURFACE_ERROR_INVALID_PARAM;
     }
-    ExtraData extData = extDatas_[key];
-    *data = extData.value;
-    *size = extData.size;
-    *type = extData.type;
+    *data = (extData->type == BUFFER_DATA_TYPE_BLOB) ? extData->value.blob : extData->value.bytes;
+    *size = extData->size;
+    *type = extData->type;
     return SURFACE_ERROR_OK;
 }
 
-void SurfaceBufferImpl::ReadFromIpcIo(IpcIo& io)
+bool SurfaceBufferImpl::ReadFromIpcIo(IpcIo& io)
+{
+    if (!ReadAttrFromIpcIo(io)) {
+        return false;
+    }
+    ReadExtraDataFromIpcIo(io);
+    return true;
+}
+
+bool SurfaceBufferImpl::ReadAttrFromIpcIo(IpcIo& io)
 {
-    ReadInt32(&io, &(bufferData_.handle.key));
-    ReadUint64(&io, &(bufferData_.handle.phyAddr));
-    ReadUint32(&io, &(bufferData_.handle.reserveFds));
-    ReadUint32(&io, &(bufferData_.handle.reserveInts));
-    ReadUint32(&io, &(bufferData_.size));
-    ReadUint32(&io, &(bufferData_.usage));
-    ReadUint32(&io, &len_);
-    uint32_t extDataSize;
+    uint32_t length = 0;
+    ReadUint32(&io, &length);
+    const void* data = ReadBuffer(&io, length);
+    BufferWireData wire;
+    /* Newer versions append fields, which are ignored. */
+    if ((data == nullptr) || (length < sizeof(wire)) ||
+        (memcpy_s(&wire, sizeof(wire), data, sizeof(wire)) != EOK) || (wire.version < BUFFER_WIRE_VERSION)) {
+        GRAPHIC_LOGW("Invalid buffer wire data of %u bytes.", length);
+        return false;
+    }
+    if ((wire.planeCount > SURFACE_MAX_PLANE_NUM) ||
+        (SetReserve(wire.reserve, wire.reserveFds, wire.reserveInts) != SURFACE_ERROR_OK)) {
+        GRAPHIC_LOGW("Invalid buffer wire data.");
+        return false;
+    }
+    bufferData_.handle.key = wire.key;
+    bufferData_.handle.phyAddr = wire.phyAddr;
+    bufferData_.handle.stride = wire.stride;
+    bufferData_.size = wire.size;
+    bufferData_.usage = wire.usage;
+    len_ = wire.len;
+    SetPlanes(wire.planes, static_cast<uint8_t>(wire.planeCount));
+    return true;
+}
+
+int32_t SurfaceBufferImpl::ReadExtraDataFromIpcIo(IpcIo& io)
+{
+    uint64_t baseVersion = 0;
+    uint64_t version = 0;
+    ReadUint64(&io, &baseVersion);
+    ReadUint64(&io, &version);
+    if (baseVersion != 0) {
+        if (ipcBaseline_ == nullptr || ipcVersion_ != baseVersion) {
+            GRAPHIC_LOGI("Extra data delta is based on a stale version.");
+            return SURFACE_ERROR_DATA_STALE;
+        }
+        CopyExtraData(*ipcBaseline_);
+    } else if (version != 0) {
+        ClearExtraData();
+    }
+    uint32_t extDataSize = 0;
     ReadUint32(&io, &extDataSize);
     if (extDataSize > 0 && extDataSize < MAX_USER_DATA_COUNT) {
         for (uint32_t i = 0; i < extDataSize; i++) {
@@ -152,59 +431,372 @@ void SurfaceBufferImpl::ReadFromIpcIo(IpcIo& io)
                     SetInt64(key, value);
                     break;
                 }
+                case BUFFER_DATA_TYPE_BLOB:
+                    ReadBlobFromIpcIo(io, key);
+                    break;
+                case BUFFER_DATA_TYPE_NONE:
+                    RemoveData(key);
+                    break;
                 default:
                     break;
             }
         }
     }
+    ReadFrameMetadata(io);
+    if (version == 0) {
+        ipcVersion_ = 0;
+        return SURFACE_ERROR_OK;
+    }
+    UpdateIpcBaseline(version);
+    return SURFACE_ERROR_OK;
 }
-void SurfaceBufferImpl::WriteToIpcIo(IpcIo& io)
+
+void SurfaceBufferImpl::ReadFrameMetadata(IpcIo& io)
 {
-    WriteInt32(&io, bufferData_.handle.key);
-    WriteUint64(&io, bufferData_.handle.phyAddr);
-    WriteUint32(&io, bufferData_.handle.reserveFds);
-    WriteUint32(&io, bufferData_.handle.reserveInts);
-    WriteUint32(&io, bufferData_.size);
-    WriteUint32(&io, bufferData_.usage);
-    WriteUint32(&io, len_);
-    WriteUint32(&io, extDatas_.size());
-    if (!extDatas_.empty()) {
+    uint32_t size = 0;
+    ReadUint32(&io, &size);
+    if (size == 0) {
+        return;
+    }
+    const void* data = ReadBuffer(&io, size);
+    if (data == nullptr || size != sizeof(FrameMetadata)) {
+        GRAPHIC_LOGW("Invalid frame metadata of %u bytes.", size);
+        return;
+    }
+    if (memcpy_s(&frameMetadata_, sizeof(frameMetadata_), data, size) != EOK) {
+        frameMetadata_.fields = 0;
+        return;
+    }
+    frameMetadata_.fields &= FRAME_METADATA_MASK;
+}
+
+void SurfaceBufferImpl::WriteFrameMetadata(IpcIo& io)
+{
+    /* All fields in one block, consumers read them in place without lookup. */
+    if (frameMetadata_.fields == 0) {
+        WriteUint32(&io, 0);
+        return;
+    }
+    WriteUint32(&io, sizeof(FrameMetadata));
+    WriteBuffer(&io, &frameMetadata_, sizeof(FrameMetadata));
+}
+
+void SurfaceBufferImpl::ReadBlobFromIpcIo(IpcIo& io, uint32_t key)
+{
+    uint32_t size = 0;
+    ReadUint32(&io, &size);
+    if (size <= BLOB_IPC_INLINE_SIZE) {
+        const void* data = ReadBuffer(&io, size);
+        if (data != nullptr) {
+            SetBlob(key, data, size);
+        }
+        return;
+    }
+    bool shared = false;
+    ReadBool(&io, &shared);
+    if (!shared) {
+        /* Copied into ipc object by the sender, which does not support shared memory. */
+        const void* data = ReadBuffer(&io, size);
+        if (data != nullptr) {
+            SetBlob(key, data, size);
+        }
+        return;
+    }
+    int32_t fd = ReadFileDescriptor(&io);
+    void* blob = ReserveBlob(key, size);
+    if (blob == nullptr) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+    if (!BlobPool::ReadSharedFd(fd, blob, size)) {
+        GRAPHIC_LOGW("Read blob of key %u failed.", key);
+        /* The blob is reserved but not filled, do not expose uninitialized memory. */
+        RemoveData(key);
+    }
+}
+
+bool SurfaceBufferImpl::WriteToIpcIo(IpcIo& io, bool delta)
+{
+    WriteAttrToIpcIo(io);
+    return WriteExtraDataToIpcIo(io, delta);
+}
+
+void SurfaceBufferImpl::WriteAttrToIpcIo(IpcIo& io)
+{
+    BufferWireData wire;
+    (void)memset_s(&wire, sizeof(wire), 0, sizeof(wire));
+    wire.version = BUFFER_WIRE_VERSION;
+    wire.key = bufferData_.handle.key;
+    wire.phyAddr = bufferData_.handle.phyAddr;
+    wire.stride = bufferData_.handle.stride;
+    wire.size = bufferData_.size;
+    wire.usage = bufferData_.usage;
+    wire.len = len_;
+    wire.reserveFds = bufferData_.handle.reserveFds;
+    wire.reserveInts = bufferData_.handle.reserveInts;
+    wire.planeCount = planeCount_;
+    for (uint8_t i = 0; i < planeCount_; i++) {
+        wire.planes[i] = planes_[i];
+    }
+    for (uint32_t i = 0; i < wire.reserveFds + wire.reserveInts; i++) {
+        wire.reserve[i] = reserve_[i];
+    }
+    WriteUint32(&io, sizeof(wire));
+    WriteBuffer(&io, &wire, sizeof(wire));
+}
+
+bool SurfaceBufferImpl::WriteExtraDataToIpcIo(IpcIo& io, bool delta)
+{
+    bool ret = delta ? WriteExtraDataDelta(io) : WriteAllExtraData(io);
+    WriteFrameMetadata(io);
+    return ret;
+}
+
+bool SurfaceBufferImpl::WriteAllExtraData(IpcIo& io)
+{
+    WriteUint64(&io, 0); /* not based on any version */
+    WriteUint64(&io, 0); /* not kept as baseline */
+    WriteUint32(&io, GetExtraDataCount());
+    bool ret = true;
+    for (uint8_t i = 0; i < inlineCount_; i++) {
+        ret = WriteExtraData(io, inlineDatas_[i]) && ret;
+    }
+    std::map<uint32_t, ExtraData>::iterator iter;
+    for (iter = extDatas_.begin(); iter != extDatas_.end(); ++iter) {
+        ret = WriteExtraData(io, iter->second) && ret;
+    }
+    return ret;
+}
+
+static uint64_t NextIpcVersion()
+{
+    static pthread_mutex_t versionLock = PTHREAD_MUTEX_INITIALIZER;
+    static uint32_t sequence = 0;
+    pthread_mutex_lock(&versionLock);
+    uint32_t version = ++sequence;
+    pthread_mutex_unlock(&versionLock);
+    /* Unique among processes, a receiver never applies delta to the baseline of another sender. */
+    return (static_cast<uint64_t>(getpid()) << 32) | version; // 32: pid in high word
+}
+
+bool SurfaceBufferImpl::IsExtraDataChanged(const ExtraData& extData) const
+{
+    if (extData.type == BUFFER_DATA_TYPE_BLOB || ipcVersion_ == 0) {
+        return true;
+    }
+    const ExtraData* baseData = ipcBaseline_->FindData(extData.key);
+    return (baseData == nullptr) || (baseData->type != extData.type) || (baseData->size != extData.size) ||
+        (memcmp(baseData->value.bytes, extData.value.bytes, extData.size) != 0);
+}
+
+bool SurfaceBufferImpl::WriteExtraDataDelta(IpcIo& io)
+{
+    CreateIpcBaseline();
+    /* Keys changed since the last delta, then keys removed since then, which are written as type none. */
+    uint32_t count = 0;
+    for (uint8_t i = 0; i < inlineCount_; i++) {
+        count += IsExtraDataChanged(inlineDatas_[i]) ? 1 : 0;
+    }
+    std::map<uint32_t, ExtraData>::iterator iter;
+    for (iter = extDatas_.begin(); iter != extDatas_.end(); ++iter) {
+        count += IsExtraDataChanged(iter->second) ? 1 : 0;
+    }
+    if (ipcVersion_ != 0) {
+        for (uint8_t i = 0; i < ipcBaseline_->inlineCount_; i++) {
+            count += (FindData(ipcBaseline_->inlineDatas_[i].key) == nullptr) ? 1 : 0;
+        }
+        for (iter = ipcBaseline_->extDatas_.begin(); iter != ipcBaseline_->extDatas_.end(); ++iter) {
+            count += (FindData(iter->first) == nullptr) ? 1 : 0;
+        }
+    }
+    uint64_t version = NextIpcVersion();
+    WriteUint64(&io, ipcVersion_);
+    WriteUint64(&io, version);
+    WriteUint32(&io, count);
+    bool ret = true;
+    for (uint8_t i = 0; i < inlineCount_; i++) {
+        if (IsExtraDataChanged(inlineDatas_[i])) {
+            ret = WriteExtraData(io, inlineDatas_[i]) && ret;
+        }
+    }
+    for (iter = extDatas_.begin(); iter != extDatas_.end(); ++iter) {
+        if (IsExtraDataChanged(iter->second)) {
+            ret = WriteExtraData(io, iter->second) && ret;
+        }
+    }
+    if (ipcVersion_ != 0) {
+        for (uint8_t i = 0; i < ipcBaseline_->inlineCount_; i++) {
+            if (FindData(ipcBaseline_->inlineDatas_[i].key) == nullptr) {
+                WriteUint32(&io, ipcBaseline_->inlineDatas_[i].key);
+                WriteUint32(&io, BUFFER_DATA_TYPE_NONE);
+            }
+        }
+        for (iter = ipcBaseline_->extDatas_.begin(); iter != ipcBaseline_->extDatas_.end(); ++iter) {
+            if (FindData(iter->first) == nullptr) {
+                WriteUint32(&io, iter->first);
+                WriteUint32(&io, BUFFER_DATA_TYPE_NONE);
+            }
+        }
+    }
+    UpdateIpcBaseline(version);
+    return ret;
+}
+
+void SurfaceBufferImpl::CreateIpcBaseline()
+{
+    /* Created on the first delta, buffers never sent as delta do not keep a copy of their extra data. */
+    if (ipcBaseline_ == nullptr) {
+        ipcBaseline_ = new SurfaceBufferImpl();
+        ipcVersion_ = 0;
+    }
+}
+
+void SurfaceBufferImpl::UpdateIpcBaseline(uint64_t version)
+{
+    CreateIpcBaseline();
+    if (blobCount_ == 0) {
+        ipcBaseline_->CopyExtraData(*this);
+    } else {
+        /* Blobs are sent every time, they are not kept in baseline. */
+        ipcBaseline_->ClearExtraData();
+        for (uint8_t i = 0; i < inlineCount_; i++) {
+            const ExtraData& extData = inlineDatas_[i];
+            if (extData.type != BUFFER_DATA_TYPE_BLOB) {
+                ipcBaseline_->SetData(extData.key, extData.type, extData.value.bytes, extData.size);
+            }
+        }
         std::map<uint32_t, ExtraData>::iterator iter;
         for (iter = extDatas_.begin(); iter != extDatas_.end(); ++iter) {
-            uint32_t key = iter->first;
-            ExtraData value = iter->second;
-            WriteUint32(&io, key);
-            WriteUint32(&io, value.type);
-            switch (value.type) {
-                case BUFFER_DATA_TYPE_INT_32:
-                    WriteInt32(&io, *(reinterpret_cast<int32_t *>(value.value)));
-                    break;
-                case BUFFER_DATA_TYPE_INT_64:
-                    WriteInt64(&io, *(reinterpret_cast<int64_t *>(value.value)));
-                    break;
-                default:
-                    break;
+            if (iter->second.type != BUFFER_DATA_TYPE_BLOB) {
+                ipcBaseline_->SetData(iter->first, iter->second.type, iter->second.value.bytes, iter->second.size);
+            }
+        }
+    }
+    ipcVersion_ = version;
+}
+
+bool SurfaceBufferImpl::WriteExtraData(IpcIo& io, const ExtraData& extData)
+{
+    WriteUint32(&io, extData.key);
+    WriteUint32(&io, extData.type);
+    switch (extData.type) {
+        case BUFFER_DATA_TYPE_INT_32:
+            WriteInt32(&io, extData.value.int32Value);
+            break;
+        case BUFFER_DATA_TYPE_INT_64:
+            WriteInt64(&io, extData.value.int64Value);
+            break;
+        case BUFFER_DATA_TYPE_BLOB: {
+            /* Small blobs are copied, larger ones are passed by shared memory to keep ipc object small. */
+            WriteUint32(&io, extData.size);
+            if (extData.size <= BLOB_IPC_INLINE_SIZE) {
+                return WriteBuffer(&io, extData.value.blob, extData.size);
+            }
+            int32_t fd = BlobPool::GetSharedFd(extData.value.blob, extData.size);
+            WriteBool(&io, fd >= 0);
+            if (fd >= 0) {
+                return WriteFileDescriptor(&io, fd);
             }
+            /* Without shared memory, copied into ipc object if it fits, the sender fails otherwise. */
+            if (!WriteBuffer(&io, extData.value.blob, extData.size)) {
+                GRAPHIC_LOGW("Blob of key %u is too large to copy into ipc object.", extData.key);
+                return false;
+            }
+            break;
         }
+        default:
+            break;
     }
+    return true;
 }
 
-void SurfaceBufferImpl::CopyExtraData(SurfaceBufferImpl& buffer)
+void SurfaceBufferImpl::MoveExtraData(SurfaceBufferImpl& buffer)
 {
+    ClearExtraData();
     len_ = buffer.len_;
-    extDatas_ = buffer.extDatas_;
-    buffer.extDatas_.clear();
+    /* The in place entries are bounded by EXTRA_DATA_INLINE_NUM, the overflow map is swapped. */
+    if (buffer.inlineCount_ > 0) {
+        (void)memcpy_s(inlineDatas_, sizeof(inlineDatas_), buffer.inlineDatas_,
+            buffer.inlineCount_ * sizeof(ExtraData));
+    }
+    inlineCount_ = buffer.inlineCount_;
+    extDatas_.swap(buffer.extDatas_);
+    blobCount_ = buffer.blobCount_;
+    buffer.blobCount_ = 0;
+    if (buffer.frameMetadata_.fields != 0) {
+        frameMetadata_ = buffer.frameMetadata_;
+    }
+    buffer.ClearExtraData();
+}
+
+void SurfaceBufferImpl::CopyExtraData(const SurfaceBufferImpl& buffer)
+{
+    /* Only for extra data without blobs, which are owned by one buffer. */
+    ClearExtraData();
+    if (buffer.inlineCount_ > 0) {
+        (void)memcpy_s(inlineDatas_, sizeof(inlineDatas_), buffer.inlineDatas_,
+            buffer.inlineCount_ * sizeof(ExtraData));
+    }
+    inlineCount_ = buffer.inlineCount_;
+    if (!buffer.extDatas_.empty()) {
+        extDatas_ = buffer.extDatas_;
+    }
+}
+
+void SurfaceBufferImpl::RemoveData(uint32_t key)
+{
+    ExtraData* end = inlineDatas_ + inlineCount_;
+    ExtraData* extData = std::lower_bound(inlineDatas_, end, key, CompareExtraDataKey);
+    if (extData != end && extData->key == key) {
+        if (extData->type == BUFFER_DATA_TYPE_BLOB) {
+            BlobPool::Free(extData->value.blob);
+            blobCount_--;
+        }
+        size_t moveSize = (end - extData - 1) * sizeof(ExtraData);
+        if (moveSize > 0) {
+            (void)memmove_s(extData, moveSize, extData + 1, moveSize);
+        }
+        inlineCount_--;
+        return;
+    }
+    std::map<uint32_t, ExtraData>::iterator iter = extDatas_.find(key);
+    if (iter == extDatas_.end()) {
+        return;
+    }
+    if (iter->second.type == BUFFER_DATA_TYPE_BLOB) {
+        BlobPool::Free(iter->second.value.blob);
+        blobCount_--;
+    }
+    extDatas_.erase(iter);
+}
+
+void SurfaceBufferImpl::FreeBlobs()
+{
+    if (blobCount_ == 0) {
+        return;
+    }
+    for (uint8_t i = 0; i < inlineCount_; i++) {
+        if (inlineDatas_[i].type == BUFFER_DATA_TYPE_BLOB) {
+            BlobPool::Free(inlineDatas_[i].value.blob);
+        }
+    }
+    std::map<uint32_t, ExtraData>::iterator iter;
+    for (iter = extDatas_.begin(); iter != extDatas_.end(); ++iter) {
+        if (iter->second.type == BUFFER_DATA_TYPE_BLOB) {
+            BlobPool::Free(iter->second.value.blob);
+        }
+    }
+    blobCount_ = 0;
 }
 
 void SurfaceBufferImpl::ClearExtraData()
 {
+    FreeBlobs();
+    frameMetadata_.fields = 0;
+    inlineCount_ = 0;
     if (!extDatas_.empty()) {
-        std::map<uint32_t, ExtraData>::iterator iter;
-        for (iter = extDatas_.begin(); iter != extDatas_.end(); ++iter) {
-            ExtraData value = iter->second;
-            free(value.value);
-            value.value = nullptr;
-        }
         extDatas_.clear();
     }
 }
@@ -212,7 +804,9 @@ void SurfaceBufferImpl::ClearExtraData()
 SurfaceBufferImpl::~SurfaceBufferImpl()
 {
     ClearExtraData();
-    struct SurfaceBufferData bufferData = {{0}, 0, 0, 0, BUFFER_STATE_NONE, NULL};
+    delete ipcBaseline_;
+    ipcBaseline_ = nullptr;
+    struct SurfaceBufferData bufferData = {{0}, 0, 0, 0, 0, IMAGE_PIXEL_FORMAT_NONE, 0, BUFFER_STATE_NONE, NULL};
     bufferData_ = bufferData;
 }
 }
@@ -135,6 +135,7 @@ void SurfaceImpl::SetStrideAlignment(uint32_t strideAlignment)
 {
     RETURN_IF_FAIL(producer_);
     RETURN_IF_FAIL(strideAlignment >= SURFACE_MIN_STRIDE_ALIGNMENT && strideAlignment <= SURFACE_MAX_STRIDE_ALIGNMENT);
+    RETURN_IF_FAIL((strideAlignment & (strideAlignment - 1)) == 0);
     producer_->SetStrideAlignment(strideAlignment);
 }
 
@@ -216,6 +217,18 @@ int32_t SurfaceImpl::FlushBuffer(SurfaceBuffer* buffer)
     return producer_->FlushBuffer(liteBuffer);
 }
 
+int32_t SurfaceImpl::FlushAndRequestBuffer(SurfaceBuffer* buffer, SurfaceBuffer*& next, uint8_t wait)
+{
+    next = nullptr;
+    RETURN_VAL_IF_FAIL(producer_, SURFACE_ERROR_INVALID_PARAM);
+    RETURN_VAL_IF_FAIL(buffer != nullptr, SURFACE_ERROR_INVALID_PARAM);
+    SurfaceBufferImpl* liteBuffer = reinterpret_cast<SurfaceBufferImpl*>(buffer);
+    SurfaceBufferImpl* nextBuffer = nullptr;
+    int32_t ret = producer_->FlushAndRequestBuffer(liteBuffer, nextBuffer, wait);
+    next = nextBuffer;
+    return ret;
+}
+
 SurfaceBuffer* SurfaceImpl::AcquireBuffer()
 {
     RETURN_VAL_IF_FAIL(consumer_, nullptr);
@@ -237,6 +250,73 @@ void SurfaceImpl::CancelBuffer(SurfaceBuffer* buffer)
     producer_->Cancel(liteBuffer);
 }
 
+int32_t SurfaceImpl::DetachBuffer(SurfaceBuffer* buffer)
+{
+    RETURN_VAL_IF_FAIL(producer_ != nullptr && IsConsumer_, SURFACE_ERROR_INVALID_REQUEST);
+    RETURN_VAL_IF_FAIL(buffer != nullptr, SURFACE_ERROR_INVALID_PARAM);
+    SurfaceBufferImpl* liteBuffer = reinterpret_cast<SurfaceBufferImpl*>(buffer);
+    BufferQueueProducer* bufferQueueProducer = reinterpret_cast<BufferQueueProducer *>(producer_);
+    return bufferQueueProducer->DetachBuffer(*liteBuffer);
+}
+
+int32_t SurfaceImpl::AttachBuffer(SurfaceBuffer* buffer, bool dirty)
+{
+    RETURN_VAL_IF_FAIL(producer_ != nullptr && IsConsumer_, SURFACE_ERROR_INVALID_REQUEST);
+    RETURN_VAL_IF_FAIL(buffer != nullptr, SURFACE_ERROR_INVALID_PARAM);
+    SurfaceBufferImpl* liteBuffer = reinterpret_cast<SurfaceBufferImpl*>(buffer);
+    BufferQueueProducer* bufferQueueProducer = reinterpret_cast<BufferQueueProducer *>(producer_);
+    return bufferQueueProducer->AttachBuffer(*liteBuffer, dirty);
+}
+
+int32_t SurfaceImpl::FreeDetachedBuffer(SurfaceBuffer* buffer)
+{
+    RETURN_VAL_IF_FAIL(producer_ != nullptr && IsConsumer_, SURFACE_ERROR_INVALID_REQUEST);
+    RETURN_VAL_IF_FAIL(buffer != nullptr, SURFACE_ERROR_INVALID_PARAM);
+    SurfaceBufferImpl* liteBuffer = reinterpret_cast<SurfaceBufferImpl*>(buffer);
+    if (liteBuffer->GetState() != BUFFER_STATE_NONE) {
+        GRAPHIC_LOGI("Buffer is attached to a surface, could not free.");
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    BufferManager* bufferManager = BufferManager::GetInstance();
+    RETURN_VAL_IF_FAIL(bufferManager, SURFACE_ERROR_NOT_READY);
+    bufferManager->FreeBuffer(&liteBuffer);
+    return SURFACE_ERROR_OK;
+}
+
+int32_t SurfaceImpl::GetAcquireEventFd()
+{
+    RETURN_VAL_IF_FAIL(consumer_, -1);
+    return consumer_->GetAcquireEventFd();
+}
+
+int32_t SurfaceImpl::GetRequestEventFd()
+{
+    RETURN_VAL_IF_FAIL(producer_ != nullptr && IsConsumer_, -1);
+    BufferQueueProducer* bufferQueueProducer = reinterpret_cast<BufferQueueProducer *>(producer_);
+    return bufferQueueProducer->GetRequestEventFd();
+}
+
+int32_t SurfaceImpl::SetIdlePolicy(uint32_t timeout, uint8_t floor)
+{
+    RETURN_VAL_IF_FAIL(producer_ != nullptr && IsConsumer_, SURFACE_ERROR_INVALID_REQUEST);
+    BufferQueueProducer* bufferQueueProducer = reinterpret_cast<BufferQueueProducer *>(producer_);
+    return bufferQueueProducer->SetIdlePolicy(timeout, floor);
+}
+
+int32_t SurfaceImpl::SetAllocFlags(uint32_t flags)
+{
+    RETURN_VAL_IF_FAIL(producer_ != nullptr && IsConsumer_, SURFACE_ERROR_INVALID_REQUEST);
+    BufferQueueProducer* bufferQueueProducer = reinterpret_cast<BufferQueueProducer *>(producer_);
+    return bufferQueueProducer->SetAllocFlags(flags);
+}
+
+uint32_t SurfaceImpl::GetAllocFlags()
+{
+    RETURN_VAL_IF_FAIL(producer_ != nullptr && IsConsumer_, BUFFER_ALLOC_FLAG_NONE);
+    BufferQueueProducer* bufferQueueProducer = reinterpret_cast<BufferQueueProducer *>(producer_);
+    return bufferQueueProducer->GetAllocFlags();
+}
+
 void SurfaceImpl::RegisterConsumerListener(IBufferConsumerListener& listener)
 {
     RETURN_IF_FAIL(producer_);
@@ -251,6 +331,28 @@ void SurfaceImpl::UnregisterConsumerListener()
     bufferQueueProducer->UnregisterConsumerListener();
 }
 
+int32_t SurfaceImpl::SetAsyncMode(bool async)
+{
+    RETURN_VAL_IF_FAIL(producer_ != nullptr && !IsConsumer_, SURFACE_ERROR_INVALID_REQUEST);
+    BufferClientProducer* bufferClientProducer = reinterpret_cast<BufferClientProducer *>(producer_);
+    bufferClientProducer->SetAsyncMode(async);
+    return SURFACE_ERROR_OK;
+}
+
+void SurfaceImpl::RegisterProducerListener(IBufferProducerListener& listener)
+{
+    RETURN_IF_FAIL(producer_ != nullptr && !IsConsumer_);
+    BufferClientProducer* bufferClientProducer = reinterpret_cast<BufferClientProducer *>(producer_);
+    bufferClientProducer->RegisterProducerListener(listener);
+}
+
+void SurfaceImpl::UnregisterProducerListener()
+{
+    RETURN_IF_FAIL(producer_ != nullptr && !IsConsumer_);
+    BufferClientProducer* bufferClientProducer = reinterpret_cast<BufferClientProducer *>(producer_);
+    bufferClientProducer->UnregisterProducerListener();
+}
+
 void SurfaceImpl::WriteIoIpcIo(IpcIo& io)
 {
     WriteRemoteObject(&io, &sid_);
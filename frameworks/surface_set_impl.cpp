@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "surface_set_impl.h"
+
+#include <cerrno>
+#include <ctime>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "buffer_common.h"
+
+namespace OHOS {
+const int32_t SURFACE_SET_MAX_EVENTS = 16;
+const int64_t MSEC_PER_SEC = 1000;
+const int64_t NSEC_PER_MSEC = 1000000;
+
+static int64_t GetNowMs()
+{
+    struct timespec now = {0};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * MSEC_PER_SEC + now.tv_nsec / NSEC_PER_MSEC;
+}
+
+SurfaceSet* SurfaceSet::CreateSurfaceSet()
+{
+    SurfaceSetImpl* surfaceSet = new SurfaceSetImpl();
+    if (surfaceSet != nullptr) {
+        if (surfaceSet->Init()) {
+            return surfaceSet;
+        }
+        GRAPHIC_LOGE("surface set init failed");
+        delete surfaceSet;
+    }
+    return nullptr;
+}
+
+SurfaceSet::~SurfaceSet()
+{
+}
+
+SurfaceSetImpl::SurfaceSetImpl() : epollFd_(-1)
+{
+}
+
+SurfaceSetImpl::~SurfaceSetImpl()
+{
+    readyList_.clear();
+    std::map<Surface*, SurfaceEntry*>::iterator iter;
+    for (iter = entries_.begin(); iter != entries_.end(); ++iter) {
+        delete iter->second;
+    }
+    entries_.clear();
+    if (epollFd_ >= 0) {
+        close(epollFd_);
+        epollFd_ = -1;
+    }
+}
+
+bool SurfaceSetImpl::Init()
+{
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd_ < 0) {
+        GRAPHIC_LOGE("Create epoll failed, errno=%d", errno);
+        return false;
+    }
+    return true;
+}
+
+int32_t SurfaceSetImpl::AddSurface(Surface* surface)
+{
+    RETURN_VAL_IF_FAIL(surface != nullptr, SURFACE_ERROR_INVALID_PARAM);
+    if (entries_.find(surface) != entries_.end()) {
+        GRAPHIC_LOGI("Surface has been added.");
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    int32_t fd = surface->GetAcquireEventFd();
+    if (fd < 0) {
+        GRAPHIC_LOGW("Surface has no acquire event fd.");
+        return SURFACE_ERROR_INVALID_REQUEST;
+    }
+    SurfaceEntry* entry = new SurfaceEntry();
+    if (entry == nullptr) {
+        return SURFACE_ERROR_SYSTEM_ERROR;
+    }
+    entry->surface = surface;
+    entry->fd = fd;
+    entry->ready = false;
+    struct epoll_event event = {0};
+    event.events = EPOLLIN;
+    event.data.ptr = entry;
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+        GRAPHIC_LOGE("Watch surface failed, errno=%d", errno);
+        delete entry;
+        return SURFACE_ERROR_SYSTEM_ERROR;
+    }
+    entries_[surface] = entry;
+    return SURFACE_ERROR_OK;
+}
+
+int32_t SurfaceSetImpl::RemoveSurface(Surface* surface)
+{
+    std::map<Surface*, SurfaceEntry*>::iterator iter = entries_.find(surface);
+    if (iter == entries_.end()) {
+        return SURFACE_ERROR_INVALID_PARAM;
+    }
+    SurfaceEntry* entry = iter->second;
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, entry->fd, nullptr);
+    if (entry->ready) {
+        readyList_.remove(entry);
+    }
+    entries_.erase(iter);
+    delete entry;
+    return SURFACE_ERROR_OK;
+}
+
+int32_t SurfaceSetImpl::WaitReady(int32_t timeout)
+{
+    struct epoll_event events[SURFACE_SET_MAX_EVENTS];
+    int32_t count = epoll_wait(epollFd_, events, SURFACE_SET_MAX_EVENTS, timeout);
+    if (count < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        GRAPHIC_LOGW("Wait surface failed, errno=%d", errno);
+        return count;
+    }
+    for (int32_t i = 0; i < count; i++) {
+        SurfaceEntry* entry = static_cast<SurfaceEntry*>(events[i].data.ptr);
+        if (!entry->ready) {
+            entry->ready = true;
+            readyList_.push_back(entry);
+        }
+    }
+    return count;
+}
+
+SurfaceBuffer* SurfaceSetImpl::AcquireAny(Surface*& surface, int32_t timeout)
+{
+    int64_t deadline = (timeout > 0) ? (GetNowMs() + timeout) : 0;
+    while (true) {
+        while (!readyList_.empty()) {
+            SurfaceEntry* entry = readyList_.front();
+            readyList_.pop_front();
+            entry->ready = false;
+            SurfaceBuffer* buffer = entry->surface->AcquireBuffer();
+            if (buffer != nullptr) {
+                surface = entry->surface;
+                return buffer;
+            }
+        }
+        int32_t wait = timeout;
+        if (timeout > 0) {
+            int64_t left = deadline - GetNowMs();
+            wait = (left > 0) ? static_cast<int32_t>(left) : 0;
+        }
+        int32_t count = WaitReady(wait);
+        if (count < 0) {
+            return nullptr;
+        }
+        if (count == 0 && (timeout == 0 || (timeout > 0 && GetNowMs() >= deadline))) {
+            return nullptr;
+        }
+    }
+}
+} // end namespace OHOS
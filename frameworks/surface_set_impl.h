@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GRAPHIC_LITE_SURFACE_SET_IMPL_H
+#define GRAPHIC_LITE_SURFACE_SET_IMPL_H
+
+#include <list>
+#include <map>
+#include "surface_set.h"
+
+namespace OHOS {
+/**
+ * @brief Surface set class. Wait on the acquire event fd of all surfaces with one epoll instance,
+ *        only the ready surfaces are visited on each wake-up.
+ */
+class SurfaceSetImpl : public SurfaceSet {
+public:
+    /**
+     * @brief Surface set Constructor.
+     */
+    SurfaceSetImpl();
+
+    /**
+     * @brief Surface set Destructor. Surfaces in the set are not deleted.
+     */
+    ~SurfaceSetImpl();
+
+    /**
+     * @brief Surface set init succeed or not.
+     * @returns Init succeed return true, else return false.
+     */
+    bool Init();
+
+    /**
+     * @brief Add consumer surface to the set, watch its acquire event fd.
+     * @param [in] Surface pointer.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t AddSurface(Surface* surface) override;
+
+    /**
+     * @brief Remove consumer surface from the set.
+     * @param [in] Surface pointer.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t RemoveSurface(Surface* surface) override;
+
+    /**
+     * @brief Acquire buffer from the next ready surface. Ready surfaces are served in round-robin order.
+     * @param [out] surface, which surface the buffer is acquired from.
+     * @param [in] timeout, wait time in milliseconds. 0 is no wait, negative is waiting util buffer available.
+     * @returns buffer pointer.
+     */
+    SurfaceBuffer* AcquireAny(Surface*& surface, int32_t timeout) override;
+
+private:
+    struct SurfaceEntry {
+        Surface* surface;
+        int32_t fd;
+        bool ready;
+    };
+    int32_t WaitReady(int32_t timeout);
+    int32_t epollFd_;
+    std::map<Surface*, SurfaceEntry*> entries_;
+    std::list<SurfaceEntry*> readyList_;
+};
+} // end namespace
+#endif
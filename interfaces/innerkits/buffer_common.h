@@ -39,6 +39,7 @@ enum BufferErrorCode {
     SURFACE_ERROR_NOT_READY,
     SURFACE_ERROR_SYSTEM_ERROR,
     SURFACE_ERROR_BUFFER_NOT_EXISTED,
+    SURFACE_ERROR_DATA_STALE,
     SURFACE_ERROR_OK = 0,
 };
 } // end namespace
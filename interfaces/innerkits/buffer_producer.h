@@ -28,21 +28,15 @@ typedef enum {
     FLUSH_BUFFER,
     CANCEL_BUFFER,
     SET_QUEUE_SIZE,
-    GET_QUEUE_SIZE,
     SET_WIDTH_AND_HEIGHT,
-    GET_WIDTH,
-    GET_HEIGHT,
     SET_FORMAT,
-    GET_FORMAT,
     SET_STRIDE_ALIGNMENT,
-    GET_STRIDE_ALIGNMENT,
-    GET_STRIDE,
     SET_SIZE,
-    GET_SIZE,
     SET_USAGE,
-    GET_USAGE,
     SET_USER_DATA,
     GET_USER_DATA,
+    GET_CONFIG,
+    FLUSH_AND_REQUEST,
     MAX_REQUEST_CODE,
 } SURFACE_REQUEST_CODE;
 } // end extern
@@ -78,6 +72,16 @@ public:
      */
     virtual int32_t FlushBuffer(SurfaceBufferImpl* buffer) = 0;
 
+    /**
+     * @brief Flush buffer and request next buffer at once, for producers which render frame by frame.
+     * @param [in] SurfaceBufferImpl pointer, Which buffer could acquire for consumer.
+     * @param [out] next, the requested buffer, nullptr if flush failed or no buffer could be requested.
+     * @param [in] whether waiting or not for next buffer.
+     * @returns Flush buffer succeed or not.
+     *        0 is succeed; other is failed.
+     */
+    virtual int32_t FlushAndRequestBuffer(SurfaceBufferImpl* buffer, SurfaceBufferImpl*& next, uint8_t wait) = 0;
+
     /**
      * @brief Cancel buffer. Producer cancel this buffer, buffer will push to free list for request it.
      * @param [in] SurfaceBufferImpl pointer, Which buffer will push back to free list for request it.
@@ -18,20 +18,21 @@
 
 #include <list>
 #include <map>
+#include <utility>
 #include "surface_buffer_impl.h"
 
 namespace OHOS {
-const static int8_t SURFACE_MAX_PLANE_NUM = 4;
-struct PlaneInfo {
+/* Attributes of buffer queue, read by remote producers in one request. */
+struct BufferQueueConfig {
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
     uint32_t stride;
-    uint32_t offset;
     uint32_t size;
-};
-
-enum PLANE_COUNT {
-    IMAGE_PIXEL_FORMAT_PLANE_COUNT_RGB = 1,
-    IMAGE_PIXEL_FORMAT_PLANE_COUNT_YUVSPXX,
-    IMAGE_PIXEL_FORMAT_PLANE_COUNT_YUV4XX
+    uint32_t usage;
+    uint32_t strideAlignment;
+    uint32_t queueSize;
+    uint32_t generation; /* see BufferQueue::GetConfigGeneration */
 };
 
 class BufferQueue {
@@ -60,11 +61,13 @@ public:
     /**
      * @brief Flush buffer to dirty list, for consumer acquire. When producer flush buffer, buffer
      *        will push to dirty list, and call back to consumer that buffer is available to acquire.
+     *        Extra data of the input buffer is moved to the buffer in queue.
      * @param [in] SurfaceBufferImpl, Which buffer could acquire for consumer.
+     * @param [in] IpcIo pointer, if not null, extra data is decoded from it directly into the buffer in queue.
      * @returns Flush buffer succeed or not.
      *        0 is succeed; other is failed.
      */
-    int32_t FlushBuffer(SurfaceBufferImpl& buffer);
+    int32_t FlushBuffer(SurfaceBufferImpl& buffer, IpcIo* extraData = nullptr);
 
     /**
      * @brief Acquire buffer. Consumer acquire buffer, which producer has flush and push to free list.
@@ -86,6 +89,24 @@ public:
      */
     int32_t CancelBuffer(const SurfaceBufferImpl& buffer);
 
+    /**
+     * @brief Detach buffer. Remove a requested or acquired buffer from this queue without freeing it, so that
+     *        it could be attached to another queue. The buffer memory and its extra data are kept, the caller
+     *        owns the buffer until it is attached again.
+     * @param [in] SurfaceBufferImpl, Which buffer need to detach.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t DetachBuffer(const SurfaceBufferImpl& buffer);
+
+    /**
+     * @brief Attach buffer. Take over a buffer detached from another queue.
+     * @param [in] SurfaceBufferImpl, Which buffer need to attach.
+     * @param [in] dirty, push the buffer to dirty list for consumer acquire it if true,
+     *        otherwise push it to free list for producer request it.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t AttachBuffer(SurfaceBufferImpl& buffer, bool dirty);
+
     /**
      * @brief Set queue size, alloc max buffer count.
      *        Default is 1. Max count is 10.
@@ -190,6 +211,92 @@ public:
      */
     std::string GetUserData(const std::string& key);
 
+    /**
+     * @brief Get dirty event fd. The fd is readable as long as dirty list has buffer, so consumer could poll
+     *        or epoll it instead of waiting for the consumer listener. Do not read or close the fd.
+     * @returns The event fd, -1 if create failed.
+     */
+    int32_t GetDirtyEventFd();
+
+    /**
+     * @brief Get free event fd. The fd is readable as long as producer could request buffer without waiting,
+     *        that is free list has buffer or a new buffer could be allocated. Do not read or close the fd.
+     * @returns The event fd, -1 if create failed.
+     */
+    int32_t GetFreeEventFd();
+
+    /**
+     * @brief Get the buffer generation, which is increased whenever a buffer leaves the queue or is going to
+     *        be freed. Remote producers keep their mapped buffers as long as the generation is unchanged.
+     * @returns The buffer generation.
+     */
+    uint32_t GetGeneration();
+
+    /**
+     * @brief Get the config generation, which is increased whenever an attribute of BufferQueueConfig changes.
+     *        Remote producers keep their snapshot of the attributes as long as the generation is unchanged.
+     * @returns The config generation.
+     */
+    uint32_t GetConfigGeneration();
+
+    /**
+     * @brief Get all attributes of BufferQueueConfig at once.
+     * @param [out] config, the attributes and the config generation.
+     */
+    void GetConfig(BufferQueueConfig& config);
+
+    /**
+     * @brief Find the buffer attached in slot, which remote producers refer to instead of the whole buffer handle.
+     * @param [in] slot, the slot of buffer.
+     * @param [in] key, the key of buffer, to verify the buffer in slot.
+     * @param [out] buffer, the buffer which is identified as the buffer in slot.
+     * @returns Whether the buffer is found or not.
+     */
+    bool GetSlotBuffer(uint32_t slot, int32_t key, SurfaceBufferImpl& buffer);
+
+    /**
+     * @brief Get the buffers in free list, least recently used first.
+     * @param [out] buffers, appended by pairs of the monotonic time in milliseconds since the buffer is idle,
+     *        and the buffer.
+     */
+    void GetFreeBuffers(std::list<std::pair<int64_t, SurfaceBufferImpl*>>& buffers);
+
+    /**
+     * @brief Remove the buffer from free list, it could be attached again on demand.
+     * @param [in] buffer, got by GetFreeBuffers.
+     * @returns Whether the buffer is removed to be freed by caller, false if it is not in free list any more.
+     */
+    bool TrimFree(SurfaceBufferImpl* buffer);
+
+    /**
+     * @brief Set idle policy. After no request for timeout milliseconds, buffers in free list are freed until
+     *        floor buffers remain, they are attached again on demand.
+     * @param [in] timeout, idle time in milliseconds, 0 is disable.
+     * @param [in] floor, min buffer count to keep.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t SetIdlePolicy(uint32_t timeout, uint8_t floor);
+
+    /**
+     * @brief Free buffers in free list until floor buffers of the idle policy remain, as the idle timeout does.
+     *        The memory is returned to the system, not kept in the buffer cache.
+     * @returns The count of freed buffers.
+     */
+    uint32_t TrimIdle();
+
+    /**
+     * @brief Set allocation flags. Buffers in free list are freed, and allocated again with the flags.
+     * @param [in] flags, combination of BufferAllocFlag.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t SetAllocFlags(uint32_t flags);
+
+    /**
+     * @brief Get allocation flags.
+     * @returns combination of BufferAllocFlag.
+     */
+    uint32_t GetAllocFlags();
+
     /**
      * @brief Buffer queue init succeed or not.
      * @returns Whether init or not.
@@ -200,9 +307,17 @@ private:
     bool CanRequest(uint8_t wait);
     int32_t isValidAttr(uint32_t width, uint32_t height, uint32_t format, uint32_t strideAlignment);
     int32_t Reset(uint32_t size = 0);
-    void NeedAttach();
+    bool NeedAttach();
+    static void AllocWork(void* owner);
+    static void IdleWork(void* owner);
+    bool CanAttach();
+    bool IsAttachable(const SurfaceBufferImpl& buffer) const;
+    int32_t GetEventFd(int32_t& fd, bool& ready);
+    void SetEventFdReady(int32_t fd, bool& ready, bool newReady);
+    void UpdateReadiness();
     void Detach(SurfaceBufferImpl* buffer);
     SurfaceBufferImpl* GetBuffer(const SurfaceBufferImpl& buffer);
+    void AssignSlot(SurfaceBufferImpl& buffer);
     int32_t ReleaseBuffer(const SurfaceBufferImpl& buffer, BufferState state);
     uint32_t width_;
     uint32_t height_;
@@ -212,7 +327,12 @@ private:
     uint32_t size_;
     uint8_t queueSize_;
     uint32_t strideAlignment_;
+    uint32_t allocFlags_;
     uint8_t attachCount_;
+    uint8_t allocCount_;   /* buffers being allocated out of lock, counted as attached for queue size */
+    bool allocFailed_;
+    uint32_t resetGeneration_;  /* increased on reset, buffers allocated with old config are discarded */
+    uint32_t attrGeneration_;   /* increased on change of any attribute in BufferQueueConfig */
     bool customSize_;
     std::list<SurfaceBufferImpl *> freeList_;
     std::list<SurfaceBufferImpl *> dirtyList_;
@@ -220,6 +340,16 @@ private:
     pthread_mutex_t lock_;
     pthread_cond_t freeCond_;
     std::map<std::string, std::string> usrDataMap_;
+    int32_t dirtyEventFd_;
+    int32_t freeEventFd_;
+    bool dirtyReady_;
+    bool freeReady_;
+    uint32_t generation_;
+    uint32_t idleTimeout_;
+    uint8_t idleFloor_;
+    bool idleScheduled_;
+    int64_t lastRequestTime_;
+    BlobPool* blobPool_; /* recycles blob extra data of the buffers */
 };
 } // end namespace
 #endif
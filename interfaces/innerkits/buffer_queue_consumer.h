@@ -46,6 +46,12 @@ public:
      */
     bool ReleaseBuffer(const SurfaceBufferImpl& buffer);
 
+    /**
+     * @brief Get the event fd which is readable when some buffer could be acquired.
+     * @returns The event fd, -1 if failed.
+     */
+    int32_t GetAcquireEventFd();
+
     /**
      * @brief Set Buffer Queue to acquire and release buffer.
      * @param [in] Buffer Queue pointer, Which buffer need to release.
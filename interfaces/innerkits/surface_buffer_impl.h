@@ -23,6 +23,8 @@
 #include "surface_buffer.h"
 
 namespace OHOS {
+class BlobPool;
+
 enum BufferState {
     BUFFER_STATE_NONE = 0,
     BUFFER_STATE_REQUEST,
@@ -35,6 +37,7 @@ enum BufferDataType {
     BUFFER_DATA_TYPE_NONE,
     BUFFER_DATA_TYPE_INT_32,
     BUFFER_DATA_TYPE_INT_64,
+    BUFFER_DATA_TYPE_BLOB,
     BUFFER_DATA_TYPE_MAX,
 };
 
@@ -55,6 +58,9 @@ struct SurfaceBufferData {
     SurfaceBufferHandle handle;
     uint32_t size;
     uint32_t usage;
+    uint32_t width;   /* the width in pixels allocated with, 0 if allocated by size */
+    uint32_t height;  /* the height in pixels allocated with, 0 if allocated by size */
+    uint32_t format;  /* the pixel format allocated with, IMAGE_PIXEL_FORMAT_NONE if allocated by size */
     uint8_t deletePending;
     BufferState state;
     void* virAddr;
@@ -65,11 +71,25 @@ struct SurfaceBufferData {
 };
 
 typedef struct {
-    void* value;
-    uint8_t size;
+    uint32_t key;
+    uint32_t size;
     uint8_t type;
+    union {
+        int32_t int32Value;
+        int64_t int64Value;
+        void* blob; /* allocated by BlobPool */
+        uint8_t bytes[sizeof(int64_t)];
+    } value; /* stored in place, values are not larger than int64 */
 } ExtraData;
 
+/* Extra data kept in the buffer object without heap allocation, more keys overflow to a map. */
+const static uint8_t EXTRA_DATA_INLINE_NUM = 16;
+/* Reserved values of buffer handle carried by the buffer. */
+const static uint8_t BUFFER_RESERVE_MAX_NUM = 8;
+/* Slots of buffers attached to a queue, remote producers refer to buffers by slot once mapped. */
+const static uint32_t BUFFER_SLOT_MAX = 32;
+const static uint32_t BUFFER_SLOT_INVALID = 0xFFFFFFFF;
+
 /**
  * @brief Buffer class. Provide shared memory for graphic and multi media to use.
  */
@@ -148,15 +168,6 @@ public:
         return bufferData_.handle.reserveInts;
     }
 
-    /**
-     * @brief Set buffer reserveInts, for shared physical memory.
-     * @param [in] The buffer phyAddr
-     */
-    void SetReserveInts(uint32_t reserveInts)
-    {
-        bufferData_.handle.reserveInts = reserveInts;
-    }
-
     /**
      * @brief Get buffer reserveFds, for shared physical memory.
      * @returns The buffer phyAddr.
@@ -167,14 +178,23 @@ public:
     }
 
     /**
-     * @brief Set buffer reserveFds, for shared physical memory.
-     * @param [in] The buffer phyAddr
+     * @brief Get buffer reserved values, reserveFds fd values followed by reserveInts integer values.
+     * @returns The buffer reserved values.
      */
-    void SetReserveFds(uint32_t reserveFds)
+    const int32_t* GetReserve() const
     {
-        bufferData_.handle.reserveFds = reserveFds;
+        return reserve_;
     }
 
+    /**
+     * @brief Set buffer reserved values, filled by gralloc, for shared physical memory.
+     * @param [in] reserve, reserveFds fd values followed by reserveInts integer values.
+     * @param [in] reserveFds, the number of reserved fd values.
+     * @param [in] reserveInts, the number of reserved integer values.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t SetReserve(const int32_t* reserve, uint32_t reserveFds, uint32_t reserveInts);
+
     /**
      * @brief Set buffer virtual addr.
      * @param [in] The virtual addr.
@@ -257,6 +277,53 @@ public:
         bufferData_.usage = usage;
     }
 
+    /**
+     * @brief Get buffer width, which the buffer is allocated with. Buffer allocated by size has width 0.
+     * @returns The buffer width, in pixels.
+     */
+    uint32_t GetWidth() const
+    {
+        return bufferData_.width;
+    }
+
+    /**
+     * @brief Get buffer height, which the buffer is allocated with. Buffer allocated by size has height 0.
+     * @returns The buffer height, in pixels.
+     */
+    uint32_t GetHeight() const
+    {
+        return bufferData_.height;
+    }
+
+    /**
+     * @brief Set buffer width and height, which the buffer is allocated with.
+     * @param [in] width The buffer width, in pixels.
+     * @param [in] height The buffer height, in pixels.
+     */
+    void SetWidthAndHeight(uint32_t width, uint32_t height)
+    {
+        bufferData_.width = width;
+        bufferData_.height = height;
+    }
+
+    /**
+     * @brief Get buffer pixel format, which the buffer is allocated with. See all formats in OHOS::ImageFormat.
+     * @returns The buffer pixel format.
+     */
+    uint32_t GetFormat() const
+    {
+        return bufferData_.format;
+    }
+
+    /**
+     * @brief Set buffer pixel format, which the buffer is allocated with. See all formats in OHOS::ImageFormat.
+     * @param [in] The buffer pixel format.
+     */
+    void SetFormat(uint32_t format)
+    {
+        bufferData_.format = format;
+    }
+
     /**
      * @brief Get buffer delete state. If deletePending == 1, buffer will be freed when state == BUFFER_STATE_FREE.
      * @returns [in] The buffer delete state
@@ -325,6 +392,139 @@ public:
      */
     int32_t GetInt64(uint32_t key, int64_t& value) override;
 
+    /**
+     * @brief Set blob extra data for buffer, like <key,value>. The blob is copied to the blob pool.
+     * @param [in] key, unique uint32_t. If exited, will overlap.
+     * @param [in] data, the blob.
+     * @param [in] size, the size of the blob, not larger than SURFACE_MAX_BLOB_SIZE.
+     * @returns if succeed, return 0; else return -1.
+     */
+    int32_t SetBlob(uint32_t key, const void* data, uint32_t size) override;
+
+    /**
+     * @brief Get blob extra data for buffer, like <key,value>.
+     * @param [in] key, unique uint32_t.
+     * @param [out] data, the blob, valid until the key is set again or the extra data is cleared.
+     * @param [out] size, the size of the blob.
+     * @returns if succeed, return 0; else return -1;
+     */
+    int32_t GetBlob(uint32_t key, const void*& data, uint32_t& size) override;
+
+    /**
+     * @brief Set the standard metadata of the frame.
+     * @param [in] metadata, only the fields marked in fields are valid.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t SetFrameMetadata(const FrameMetadata& metadata) override;
+
+    /**
+     * @brief Get the standard metadata of the frame.
+     * @returns The metadata, only the fields marked in fields are valid.
+     */
+    const FrameMetadata& GetFrameMetadata() const override
+    {
+        return frameMetadata_;
+    }
+
+    /**
+     * @brief Set the pool which blob extra data is allocated from, owned by the queue of the buffer.
+     * @param [in] BlobPool pointer, nullptr is allocate from heap.
+     */
+    void SetBlobPool(BlobPool* blobPool)
+    {
+        blobPool_ = blobPool;
+    }
+
+    /**
+     * @brief Begin CPU access to a range of the buffer. The range is invalidated from CPU cache before reading,
+     *        if the buffer usage is cached.
+     * @param [in] offset, the offset of the range in bytes.
+     * @param [in] length, the length of the range in bytes.
+     * @param [in] mode, CPU_ACCESS_READ, CPU_ACCESS_WRITE or both.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t BeginCpuAccess(uint32_t offset, uint32_t length, uint32_t mode) override;
+
+    /**
+     * @brief End CPU access begun by BeginCpuAccess. The range written is flushed from CPU cache, if the buffer
+     *        usage is cached.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t EndCpuAccess() override;
+
+    /**
+     * @brief Get the number of planes.
+     * @returns The number of planes.
+     */
+    uint8_t GetPlaneCount() const override
+    {
+        return planeCount_;
+    }
+
+    /**
+     * @brief Get the layout of a plane.
+     * @param [in] index, the index of the plane in memory order.
+     * @param [out] plane, the stride, offset and size of the plane.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t GetPlane(uint8_t index, PlaneInfo& plane) const override;
+
+    /**
+     * @brief Set the plane layout, computed by buffer manager at allocation time.
+     * @param [in] planes, the planes in memory order.
+     * @param [in] count, the number of planes, not more than SURFACE_MAX_PLANE_NUM.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t SetPlanes(const PlaneInfo* planes, uint8_t count);
+
+    /**
+     * @brief Copy the plane layout of the buffer.
+     * @param [in] SurfaceBufferImpl, the buffer copy from.
+     */
+    void CopyPlanes(const SurfaceBufferImpl& buffer);
+
+    /**
+     * @brief Whether CPU writes are flushed by EndCpuAccess since the buffer was requested.
+     * @returns Whether full-buffer cache flush could be skipped or not.
+     */
+    bool IsCpuCacheFlushed() const
+    {
+        return cpuCacheFlushed_;
+    }
+
+    void SetCpuCacheFlushed(bool flushed)
+    {
+        cpuCacheFlushed_ = flushed;
+    }
+
+    /**
+     * @brief Get the monotonic time in milliseconds since the buffer is idle in the free list.
+     * @returns The idle time.
+     */
+    int64_t GetIdleTime() const
+    {
+        return idleTime_;
+    }
+
+    void SetIdleTime(int64_t idleTime)
+    {
+        idleTime_ = idleTime;
+    }
+
+    /**
+     * @brief Get the slot of buffer in the queue which it is attached to.
+     * @returns The slot, BUFFER_SLOT_INVALID if the buffer has no slot.
+     */
+    uint32_t GetSlot() const
+    {
+        return slot_;
+    }
+
+    void SetSlot(uint32_t slot)
+    {
+        slot_ = slot;
+    }
+
     /**
      * @brief Verify the two surface buffer same or not.
      * @param [in] The other SurfaceBufferImpl object
@@ -336,22 +536,64 @@ public:
     }
 
     /**
-     * @brief Get buffer attr from ipc object.
+     * @brief Get buffer attr and extra data from ipc object.
+     * @param [in] IpcIo pointer.
+     * @returns Whether the buffer attr is valid or not.
+     */
+    bool ReadFromIpcIo(IpcIo& io);
+
+    /**
+     * @brief Get buffer attr from ipc object, the extra data which follows is left in ipc object.
+     * @param [in] IpcIo pointer.
+     * @returns Whether the buffer attr is valid or not.
+     */
+    bool ReadAttrFromIpcIo(IpcIo& io);
+
+    /**
+     * @brief Get extra data from ipc object. Extra data of all keys is added to the extra data of buffer,
+     *        delta replaces the extra data of buffer with the extra data last read and the changes applied.
      * @param [in] IpcIo pointer.
+     * @returns 0 is succeed; SURFACE_ERROR_DATA_STALE if delta is not based on the extra data last read.
      */
-    void ReadFromIpcIo(IpcIo& io);
+    int32_t ReadExtraDataFromIpcIo(IpcIo& io);
 
     /**
      * @brief Write buffer attr to ipc object.
      * @param [in] IpcIo object.
+     * @param [in] delta, whether writes only the keys changed since the last delta written by the buffer.
+     * @returns Whether all extra data is written or not, see WriteExtraDataToIpcIo.
      */
-    void WriteToIpcIo(IpcIo& io);
+    bool WriteToIpcIo(IpcIo& io, bool delta = false);
 
     /**
-     * @brief Copy buffer extra data from input buffer to self
+     * @brief Write buffer attr to ipc object, without the extra data.
+     * @param [in] IpcIo object.
+     */
+    void WriteAttrToIpcIo(IpcIo& io);
+
+    /**
+     * @brief Write extra data to ipc object, which is read by ReadExtraDataFromIpcIo. Large blobs are passed by
+     *        shared memory, or copied into the ipc object if shared memory is not supported.
+     * @param [in] IpcIo object.
+     * @param [in] delta, whether writes only the keys changed since the last delta written by the buffer.
+     * @returns Whether all extra data is written or not, false if a blob could not be passed.
+     */
+    bool WriteExtraDataToIpcIo(IpcIo& io, bool delta = false);
+
+    /**
+     * @brief Forget the extra data last written as delta, so that the next delta carries all keys.
+     */
+    void ResetIpcBaseline()
+    {
+        ipcVersion_ = 0;
+    }
+
+    /**
+     * @brief Move buffer extra data from input buffer to self, the extra data of input buffer is cleared.
+     *        The cost does not grow with the number of keys.
      * @param [in] buffer pointer.
      */
-    void CopyExtraData(SurfaceBufferImpl& buffer);
+    void MoveExtraData(SurfaceBufferImpl& buffer);
 
     /**
      * @brief Clear buffer extra data.
@@ -366,11 +608,46 @@ private:
      * @data, value pointer, which storage the value;
      * @size, value length.
      */
-    int32_t SetData(uint32_t key, uint8_t type, const void* data, uint8_t size);
-    int32_t GetData(uint32_t key, uint8_t* type, void** data, uint8_t* size);
+    int32_t SetData(uint32_t key, uint8_t type, const void* data, uint32_t size);
+    int32_t GetData(uint32_t key, uint8_t* type, void** data, uint32_t* size);
+    void* ReserveBlob(uint32_t key, uint32_t size);
+    void ReadBlobFromIpcIo(IpcIo& io, uint32_t key);
+    void FreeBlobs();
+    ExtraData* FindData(uint32_t key);
+    ExtraData* InsertData(uint32_t key);
+    uint32_t GetExtraDataCount() const
+    {
+        return inlineCount_ + extDatas_.size();
+    }
+    bool WriteExtraData(IpcIo& io, const ExtraData& extData);
+    bool WriteAllExtraData(IpcIo& io);
+    void WriteFrameMetadata(IpcIo& io);
+    void ReadFrameMetadata(IpcIo& io);
+    bool WriteExtraDataDelta(IpcIo& io);
+    bool IsExtraDataChanged(const ExtraData& extData) const;
+    void RemoveData(uint32_t key);
+    void CopyExtraData(const SurfaceBufferImpl& buffer);
+    void CreateIpcBaseline();
+    void UpdateIpcBaseline(uint64_t version);
     struct SurfaceBufferData bufferData_;
-    std::map<uint32_t, ExtraData> extDatas_;
+    ExtraData inlineDatas_[EXTRA_DATA_INLINE_NUM]; /* sorted by key */
+    uint8_t inlineCount_;
+    std::map<uint32_t, ExtraData> extDatas_; /* overflow of inlineDatas_ */
+    BlobPool* blobPool_;
+    uint32_t blobCount_;
+    SurfaceBufferImpl* ipcBaseline_; /* extra data last written or read as delta, blobs excluded */
+    uint64_t ipcVersion_; /* version of ipcBaseline_, 0 is none */
+    FrameMetadata frameMetadata_;
     uint32_t len_;
+    uint32_t cpuAccessOffset_;
+    uint32_t cpuAccessLength_;
+    uint32_t cpuAccessMode_;
+    bool cpuCacheFlushed_;
+    int64_t idleTime_;
+    uint32_t slot_;
+    uint8_t planeCount_;
+    PlaneInfo planes_[SURFACE_MAX_PLANE_NUM];
+    int32_t reserve_[BUFFER_RESERVE_MAX_NUM];
 };
 } // end namespace
 #endif
@@ -172,6 +172,16 @@ public:
      */
     int32_t FlushBuffer(SurfaceBuffer* buffer) override;
 
+    /**
+     * @brief Flush buffer and request next buffer at once. Remote producers do both in one ipc request.
+     * @param [in] SurfaceBuffer pointer, Which buffer could acquire for consumer.
+     * @param [out] next, the requested buffer, nullptr if flush failed or no buffer could be requested.
+     * @param [in] whether waiting or not for next buffer.
+     * @returns Flush buffer succeed or not.
+     *        0 is succeed; other is failed.
+     */
+    int32_t FlushAndRequestBuffer(SurfaceBuffer* buffer, SurfaceBuffer*& next, uint8_t wait = 0) override;
+
     /**
      * @brief Acquire buffer. Consumer acquire buffer, which producer has flush and push to free list.
      * @returns buffer pointer.
@@ -191,6 +201,61 @@ public:
      */
     void CancelBuffer(SurfaceBuffer* buffer) override;
 
+    /**
+     * @brief Detach buffer. Remove the requested or acquired buffer from surface without freeing it.
+     * @param [in] SurfaceBuffer pointer, Which buffer need to detach.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t DetachBuffer(SurfaceBuffer* buffer) override;
+
+    /**
+     * @brief Attach buffer. Push the buffer detached from other surface to dirty list or free list.
+     * @param [in] SurfaceBuffer pointer, Which buffer need to attach.
+     * @param [in] dirty, push to dirty list for consumer acquire it if true, otherwise push to free list.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t AttachBuffer(SurfaceBuffer* buffer, bool dirty) override;
+
+    /**
+     * @brief Free detached buffer. Free the buffer which is detached and not attached to any surface.
+     * @param [in] SurfaceBuffer pointer, Which buffer need to free.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t FreeDetachedBuffer(SurfaceBuffer* buffer) override;
+
+    /**
+     * @brief Get the event fd which is readable when dirty list has buffer for consumer acquire.
+     * @returns The event fd, -1 if failed.
+     */
+    int32_t GetAcquireEventFd() override;
+
+    /**
+     * @brief Get the event fd which is readable when producer could request buffer without waiting.
+     * @returns The event fd, -1 if failed.
+     */
+    int32_t GetRequestEventFd() override;
+
+    /**
+     * @brief Set idle policy, free buffers are released after no request for timeout milliseconds.
+     * @param [in] timeout, idle time in milliseconds, 0 is disable.
+     * @param [in] floor, min buffer count to keep.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t SetIdlePolicy(uint32_t timeout, uint8_t floor) override;
+
+    /**
+     * @brief Set allocation flags, free buffers are allocated again with the flags.
+     * @param [in] flags, combination of BufferAllocFlag.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t SetAllocFlags(uint32_t flags) override;
+
+    /**
+     * @brief Get allocation flags.
+     * @returns combination of BufferAllocFlag.
+     */
+    uint32_t GetAllocFlags() override;
+
     /**
      * @brief Register consumer listener, when some buffer is available for acquired.
      *        One surface only has one consumer listener.
@@ -204,6 +269,27 @@ public:
      *        there will have no listener.
      */
     void UnregisterConsumerListener() override;
+
+    /**
+     * @brief Set whether buffers are flushed and canceled by one-way ipc requests, for the surface in producer
+     *        process only.
+     * @param [in] async, enable async mode or not.
+     * @returns 0 is succeed; other is failed.
+     */
+    int32_t SetAsyncMode(bool async) override;
+
+    /**
+     * @brief Register producer listener, which is notified of errors of one-way requests.
+     *        One surface only has one producer listener, the later one replaces the former one.
+     * @param [in] IBufferProducerListener, the producer listener.
+     */
+    void RegisterProducerListener(IBufferProducerListener& listener) override;
+
+    /**
+     * @brief Unregister producer listener, errors of one-way requests are only logged then.
+     */
+    void UnregisterProducerListener() override;
+
     /**
      * @brief Serialize Surface attr to IpcIo.
      * @param [out], IpcIo.
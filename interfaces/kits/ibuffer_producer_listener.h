@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @addtogroup Surface
+ * @{
+ *
+ * @brief Provides the capabilities of applying for and releasing shared memory in multimedia and graphics scenarios.
+ *
+ * @since 1.0
+ * @version 1.0
+ */
+
+/**
+ * @file ibuffer_producer_listener.h
+ *
+ * @brief Declares the producer listener used to notify producers of errors of asynchronous requests.
+ *
+ *
+ *
+ * @since 1.0
+ * @version 1.0
+ */
+
+#ifndef GRAPHIC_LITE_IBUFFER_PRODUCER_LISTENER_H
+#define GRAPHIC_LITE_IBUFFER_PRODUCER_LISTENER_H
+
+#include <cstdint>
+
+namespace OHOS {
+/**
+ * @brief Defines the producer listener used to notify producers of errors of asynchronous requests.
+ *
+ * @since 1.0
+ * @version 1.0
+ */
+class IBufferProducerListener {
+public:
+    /**
+     * @brief Called to notify a producer that a buffer flushed or canceled in asynchronous mode failed.
+     *
+     * The error is found by the consumer after the request has returned, so it is reported when the next reply
+     * from the consumer is received, for example by {@link Surface::RequestBuffer}.
+     *
+     * @param errorCode Indicates the error code of the failed request.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual void OnAsyncError(int32_t errorCode) = 0;
+};
+} // end namespace
+#endif
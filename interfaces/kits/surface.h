@@ -39,6 +39,7 @@
 #define GRAPHIC_LITE_SURFACE_H
 
 #include "ibuffer_consumer_listener.h"
+#include "ibuffer_producer_listener.h"
 #include "surface_buffer.h"
 #include "surface_type.h"
 
@@ -145,7 +146,7 @@ public:
     /**
      * @brief Sets the number of bytes for stride alignment.
      *
-     * By default, 4-byte aligned is used. The value range is [4,32].
+     * By default, 4-byte aligned is used. The value must be a power of 2 in the range [4,64].
      *
      * @param strideAlignment Indicates the number of bytes for stride alignment.
      * @since 1.0
@@ -236,7 +237,8 @@ public:
      * @param wait Specifies whether the function waits for an available buffer. If <b>wait</b> is <b>1</b>,
      * the function waits until there is an available buffer in the free queue before returning a pointer.
      * If the <b>wait</b> is <b>0</b>, the function does not wait and returns <b>nullptr</b> if there is no buffer
-     * in the free queue. The default value is <b>0</b>.
+     * in the free queue. The default value is <b>0</b>. Buffers are allocated in background, so a request without
+     * waiting returns <b>nullptr</b> until the first buffers are allocated.
      * @return Returns the pointer to the buffer if the operation is successful; returns <b>nullptr</b> otherwise.
      * @since 1.0
      * @version 1.0
@@ -255,6 +257,23 @@ public:
      */
     virtual int32_t FlushBuffer(SurfaceBuffer* buffer) = 0;
 
+    /**
+     * @brief Flushes a buffer to the dirty queue and obtains the next buffer to write data.
+     *
+     * This function is equivalent to {@link FlushBuffer} followed by {@link RequestBuffer}, but a producer in
+     * another process sends only one request to the consumer. The next buffer is requested only if the flush
+     * succeeds.
+     *
+     * @param buffer Indicates the pointer to the buffer flushed by producers.
+     * @param next Indicates the reference to the next buffer obtained, <b>nullptr</b> if the flush fails or no
+     * buffer is available.
+     * @param wait Specifies whether the function waits for an available buffer, see {@link RequestBuffer}.
+     * @return Returns <b>0</b> if the flush is successful; returns <b>-1</b> otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t FlushAndRequestBuffer(SurfaceBuffer* buffer, SurfaceBuffer*& next, uint8_t wait = 0) = 0;
+
     /**
      * @brief Obtains a buffer.
      *
@@ -291,6 +310,120 @@ public:
      */
     virtual void CancelBuffer(SurfaceBuffer* buffer) = 0;
 
+    /**
+     * @brief Detaches a buffer from the surface without freeing its shared memory.
+     *
+     * Only buffers obtained through {@link RequestBuffer} or {@link AcquireBuffer} can be detached. After the
+     * buffer is detached, the surface can allocate a new buffer in its place, and the detached buffer, together
+     * with its extra attributes, can be attached to another surface through {@link AttachBuffer} without copying.
+     * A detached buffer which is not attached again must be freed through {@link FreeDetachedBuffer}.
+     * This function is available only for the surface created by {@link CreateSurface}.
+     *
+     * @param buffer Indicates the pointer to the buffer to detach.
+     * @return Returns <b>0</b> if the operation is successful; returns a negative value otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t DetachBuffer(SurfaceBuffer* buffer) = 0;
+
+    /**
+     * @brief Attaches a buffer detached from another surface.
+     *
+     * The buffer is placed into the dirty queue for consumers to acquire if <b>dirty</b> is <b>true</b>, and
+     * {@link OnBufferAvailable} is called. Otherwise, the buffer is placed into the free queue for producers to
+     * request. The operation fails if the surface has already allocated {@link GetQueueSize} buffers, or if the
+     * buffer is smaller than {@link GetSize}, has a different {@link GetUsage}, or was detached after the
+     * attributes of its surface changed.
+     * This function is available only for the surface created by {@link CreateSurface}.
+     *
+     * @param buffer Indicates the pointer to the buffer to attach.
+     * @param dirty Specifies whether the buffer is placed into the dirty queue or the free queue.
+     * @return Returns <b>0</b> if the operation is successful; returns a negative value otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t AttachBuffer(SurfaceBuffer* buffer, bool dirty) = 0;
+
+    /**
+     * @brief Frees a buffer detached through {@link DetachBuffer} and not attached again.
+     *
+     * A detached buffer belongs to no surface, so it is not freed when a surface is deleted. Call this function
+     * to free it once it is no longer attached. The buffer must not be used after it is freed.
+     * This function is available only for the surface created by {@link CreateSurface}.
+     *
+     * @param buffer Indicates the pointer to the detached buffer to free.
+     * @return Returns <b>0</b> if the operation is successful; returns a negative value otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t FreeDetachedBuffer(SurfaceBuffer* buffer) = 0;
+
+    /**
+     * @brief Obtains the file descriptor that is readable whenever the dirty queue has a buffer to acquire.
+     *
+     * The file descriptor is level-triggered: it stays readable until the dirty queue becomes empty. Consumers
+     * can multiplex many surfaces on one thread by using <b>poll</b> or <b>epoll</b> on these descriptors
+     * instead of registering a consumer listener. The descriptor is owned by the surface, do not read or close it.
+     * This function is available only for the surface created by {@link CreateSurface}.
+     *
+     * @return Returns the file descriptor if the operation is successful; returns <b>-1</b> otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t GetAcquireEventFd() = 0;
+
+    /**
+     * @brief Obtains the file descriptor that is readable whenever a buffer can be requested without waiting.
+     *
+     * The descriptor is readable while the free queue has a buffer or a new buffer can still be allocated.
+     * The descriptor is owned by the surface, do not read or close it.
+     * This function is available only for the surface created by {@link CreateSurface}.
+     *
+     * @return Returns the file descriptor if the operation is successful; returns <b>-1</b> otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t GetRequestEventFd() = 0;
+
+    /**
+     * @brief Sets the idle policy of the surface.
+     *
+     * If no buffer is requested for <b>timeout</b> milliseconds, buffers in the free queue are released until
+     * <b>floor</b> buffers remain. Released buffers are allocated again when requested.
+     * This function is available only for the surface created by {@link CreateSurface}.
+     *
+     * @param timeout Indicates the idle time in milliseconds. <b>0</b> disables the policy, which is the default.
+     * @param floor Indicates the minimum number of buffers to keep.
+     * @return Returns <b>0</b> if the operation is successful; returns an error code otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t SetIdlePolicy(uint32_t timeout, uint8_t floor) = 0;
+
+    /**
+     * @brief Sets the allocation flags of the surface.
+     *
+     * Buffers in the free queue are released and allocated again with the new flags.
+     * This function is available only for the surface created by {@link CreateSurface}.
+     *
+     * @param flags Indicates the allocation flags, a combination of {@link BufferAllocFlag}.
+     * @return Returns <b>0</b> if the operation is successful; returns an error code otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t SetAllocFlags(uint32_t flags) = 0;
+
+    /**
+     * @brief Obtains the allocation flags of the surface.
+     *
+     * This function is available only for the surface created by {@link CreateSurface}.
+     *
+     * @return Returns the allocation flags, a combination of {@link BufferAllocFlag}.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual uint32_t GetAllocFlags() = 0;
+
     /**
      * @brief Registers a consumer listener.
      *
@@ -313,6 +446,44 @@ public:
      */
     virtual void UnregisterConsumerListener() = 0;
 
+    /**
+     * @brief Sets whether buffers are flushed and canceled asynchronously.
+     *
+     * In asynchronous mode, {@link FlushBuffer} and {@link CancelBuffer} return once the request is sent to the
+     * consumer, without waiting for its result. {@link FlushBuffer} returns <b>0</b> if the request is sent, and
+     * errors found by the consumer later are reported to the listener registered through
+     * {@link RegisterProducerListener}. All extra data of the buffer is sent on every asynchronous flush.
+     * This function is available only for the surface obtained from another process.
+     *
+     * @param async Specifies whether the asynchronous mode is enabled. By default, it is disabled.
+     * @return Returns <b>0</b> if the operation is successful; returns an error code otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t SetAsyncMode(bool async) = 0;
+
+    /**
+     * @brief Registers a producer listener.
+     *
+     * When an asynchronous flush or cancel fails, {@link OnAsyncError} is called to notify producers.
+     * If the listener is repeatedly registered, only the latest one is retained.
+     *
+     * @param IBufferProducerListener Indicates the listener to register.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual void RegisterProducerListener(IBufferProducerListener& listener) = 0;
+
+    /**
+     * @brief Unregisters the producer listener.
+     *
+     * After the listener is unregistered, errors of asynchronous requests are only logged.
+     *
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual void UnregisterProducerListener() = 0;
+
 protected:
     Surface() {}
 };
@@ -41,6 +41,7 @@
 #define GRAPHIC_LITE_SURFACE_BUFFER_H
 
 #include <map>
+#include "surface_type.h"
 
 namespace OHOS {
 /**
@@ -146,6 +147,119 @@ public:
      */
     virtual int32_t GetInt64(uint32_t key, int64_t& value) = 0;
 
+    /**
+     * @brief Sets an extra attribute of the binary blob type.
+     *
+     * Sets an extra attribute of the binary blob type, for example, a tile map or a histogram of the frame.
+     * The data is copied into storage recycled by the surface, and transferred with the buffer when the buffer is
+     * flushed. Each key corresponds to a value. If the key already exists, the old value is overwritten.
+     * Across processes, large blobs are passed by shared memory. Where shared memory is not supported, they are
+     * copied with the buffer, and flushing fails if they do not fit. \n
+     *
+     * @param key Indicates the key of a key-value pair to set.
+     * @param data Indicates the blob to set.
+     * @param size Indicates the size of the blob, not larger than {@link SURFACE_MAX_BLOB_SIZE}.
+     * @return Returns <b>0</b> if the operation is successful; returns <b>-1</b> otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t SetBlob(uint32_t key, const void* data, uint32_t size) = 0;
+
+    /**
+     * @brief Obtains an extra attribute value of the binary blob type.
+     *
+     * The blob is not copied. It stays valid until the attribute is set again, or the buffer is flushed or
+     * released. If the key does not exist or the value is not a blob, <b>-1</b> is returned. \n
+     *
+     * @param key Indicates the key of a key-value pair for which the value is to be obtained.
+     * @param data Indicates the blob obtained.
+     * @param size Indicates the size of the blob obtained.
+     * @return Returns <b>0</b> if the operation is successful; returns <b>-1</b> otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t GetBlob(uint32_t key, const void*& data, uint32_t& size) = 0;
+
+    /**
+     * @brief Sets the standard metadata of the frame.
+     *
+     * The metadata is transferred with the shared memory when the shared memory is flushed, and cleared when the
+     * shared memory is released. \n
+     *
+     * @param metadata Indicates the metadata to set. Only the fields marked in <b>fields</b> are valid.
+     * For details, see {@link FrameMetadata}.
+     * @return Returns <b>0</b> if the operation is successful; returns <b>-1</b> otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t SetFrameMetadata(const FrameMetadata& metadata) = 0;
+
+    /**
+     * @brief Obtains the standard metadata of the frame.
+     *
+     * The metadata is read in place without lookup. Fields not marked in <b>fields</b> are invalid. \n
+     *
+     * @return Returns the metadata. For details, see {@link FrameMetadata}.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual const FrameMetadata& GetFrameMetadata() const = 0;
+
+    /**
+     * @brief Begins CPU access to a byte range of shared memory.
+     *
+     * For shared memory using the cache, the cache of the range is invalidated when <b>mode</b> contains
+     * {@link CPU_ACCESS_READ}. To access a rectangle, pass the rows it covers, that is offset
+     * <b>y * stride</b> and length <b>height * stride</b>. Only one access can be in progress at a time. \n
+     *
+     * @param offset Indicates the start offset of the range, in bytes.
+     * @param length Indicates the length of the range, in bytes.
+     * @param mode Indicates the access mode. For details, see {@link CpuAccessMode}.
+     * @return Returns <b>0</b> if the operation is successful; returns <b>-1</b> otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t BeginCpuAccess(uint32_t offset, uint32_t length, uint32_t mode) = 0;
+
+    /**
+     * @brief Ends the CPU access begun by {@link BeginCpuAccess}.
+     *
+     * For shared memory using the cache, the cache of the range is flushed when the access mode contains
+     * {@link CPU_ACCESS_WRITE}. If all CPU writes of a frame are made inside such accesses, flushing the buffer
+     * skips the full-buffer cache flush. \n
+     *
+     * @return Returns <b>0</b> if the operation is successful; returns <b>-1</b> otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t EndCpuAccess() = 0;
+
+    /**
+     * @brief Obtains the number of planes of shared memory.
+     *
+     * RGB formats have one plane, NV12 and NV21 have two planes, and YUV420 and YVU420 have three planes.
+     * Shared memory allocated by size has one plane.
+     *
+     * @return Returns the number of planes.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual uint8_t GetPlaneCount() const = 0;
+
+    /**
+     * @brief Obtains the layout of a plane of shared memory.
+     *
+     * Planes are indexed in memory order. Plane <b>0</b> is the luma plane of YUV formats, the chroma planes
+     * follow in the order of the format name, for example, V before U for YVU420. \n
+     *
+     * @param index Indicates the index of the plane, less than {@link GetPlaneCount}.
+     * @param plane Indicates the stride, offset and size of the plane obtained.
+     * @return Returns <b>0</b> if the operation is successful; returns <b>-1</b> otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t GetPlane(uint8_t index, PlaneInfo& plane) const = 0;
+
 protected:
     SurfaceBuffer() {}
     virtual ~SurfaceBuffer() {}
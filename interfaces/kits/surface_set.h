@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2022 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @addtogroup Surface
+ * @{
+ *
+ * @brief Provides the capabilities of applying for and releasing shared memory in multimedia and graphics scenarios.
+ *
+ * @since 1.0
+ * @version 1.0
+ */
+
+/**
+ * @file surface_set.h
+ *
+ * @brief Provides the capability of acquiring buffers from many consumer surfaces with a single wait.
+ *
+ * @since 1.0
+ * @version 1.0
+ */
+
+#ifndef GRAPHIC_LITE_SURFACE_SET_H
+#define GRAPHIC_LITE_SURFACE_SET_H
+
+#include "surface.h"
+#include "surface_buffer.h"
+
+namespace OHOS {
+/**
+ * @brief Defines a set of consumer surfaces which can be waited on together.
+ *
+ * Consumers that service many surfaces, such as window managers or multi-camera recorders, register the surfaces
+ * to a set and call {@link AcquireAny} instead of polling {@link Surface::AcquireBuffer} on each one. Ready
+ * surfaces are served in round-robin order, so a surface that keeps flushing cannot starve the others. \n
+ * A surface set is not thread-safe, all of its functions must be called on the same consumer thread.
+ *
+ * @since 1.0
+ * @version 1.0
+ */
+class SurfaceSet {
+public:
+    /**
+     * @brief A constructor used to create an empty {@link SurfaceSet} object.
+     *
+     * @return Returns the pointer to the surface set if the operation is successful; returns <b>nullptr</b>
+     * otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    static SurfaceSet* CreateSurfaceSet();
+
+    /**
+     * @brief A destructor used to delete the <b>SurfaceSet</b> instance. The surfaces in the set are not deleted.
+     *
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual ~SurfaceSet();
+
+    /**
+     * @brief Adds a consumer surface to the set.
+     *
+     * The surface must be created by {@link Surface::CreateSurface} and must be removed from the set before
+     * it is deleted.
+     *
+     * @param surface Indicates the pointer to the surface to add.
+     * @return Returns <b>0</b> if the operation is successful; returns a negative value otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t AddSurface(Surface* surface) = 0;
+
+    /**
+     * @brief Removes a consumer surface from the set.
+     *
+     * @param surface Indicates the pointer to the surface to remove.
+     * @return Returns <b>0</b> if the operation is successful; returns a negative value otherwise.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual int32_t RemoveSurface(Surface* surface) = 0;
+
+    /**
+     * @brief Acquires a buffer from any surface in the set.
+     *
+     * Waits until one of the surfaces has a buffer in its dirty queue, then acquires and returns it. The buffer
+     * must be released to the returned surface through {@link Surface::ReleaseBuffer}.
+     *
+     * @param surface Indicates the surface which the buffer is acquired from.
+     * @param timeout Indicates the maximum time to wait, in milliseconds. <b>0</b> means no wait,
+     * and a negative value means waiting until a buffer is available.
+     * @return Returns the pointer to the buffer if the operation is successful; returns <b>nullptr</b> if no buffer
+     * is available before the timeout.
+     * @since 1.0
+     * @version 1.0
+     */
+    virtual SurfaceBuffer* AcquireAny(Surface*& surface, int32_t timeout) = 0;
+
+protected:
+    SurfaceSet() {}
+};
+} // end namespace
+#endif
@@ -46,11 +46,39 @@ constexpr uint16_t SURFACE_MAX_HEIGHT = 7680;
 constexpr uint16_t SURFACE_MAX_QUEUE_SIZE = 10;
 constexpr uint16_t SURFACE_MIN_QUEUE_SIZE = 1;
 constexpr uint16_t SURFACE_DEFAULT_QUEUE_SIZE = 1;
-constexpr uint16_t SURFACE_MAX_STRIDE_ALIGNMENT = 32;
+constexpr uint16_t SURFACE_MAX_STRIDE_ALIGNMENT = 64;
 constexpr uint16_t SURFACE_MIN_STRIDE_ALIGNMENT = 4;
 constexpr uint16_t SURFACE_DEFAULT_STRIDE_ALIGNMENT = 4;
+constexpr uint16_t SURFACE_MAX_PLANE_NUM = 4;
+constexpr uint32_t SURFACE_MAX_BLOB_SIZE = 1048576; // 1MB
 #define SURFACE_MAX_SIZE 58982400 // 8K * 8K
 
+/**
+ * @brief Defines the layout of a plane in shared memory.
+ *
+ */
+struct PlaneInfo {
+    /** Number of bytes between two rows of the plane */
+    uint32_t stride;
+    /** Offset of the plane from the virtual address, in bytes */
+    uint32_t offset;
+    /** Size of the plane, in bytes */
+    uint32_t size;
+};
+
+/**
+ * @brief Enumerates the number of planes of pixel formats.
+ *
+ */
+enum PLANE_COUNT {
+    /** RGB formats, one interleaved plane */
+    IMAGE_PIXEL_FORMAT_PLANE_COUNT_RGB = 1,
+    /** Semi-planar YUV formats, a luma plane and an interleaved chroma plane */
+    IMAGE_PIXEL_FORMAT_PLANE_COUNT_YUVSPXX,
+    /** Planar YUV formats, a luma plane and two chroma planes */
+    IMAGE_PIXEL_FORMAT_PLANE_COUNT_YUV4XX
+};
+
 /**
  * @brief Enumerates shared memory usage scenarios, including physically contiguous memory and virtual memory.
  *
@@ -68,5 +96,188 @@ enum BufferConsumerUsage {
      *  range. */
     BUFFER_CONSUMER_USAGE_MAX
 };
+
+/**
+ * @brief Enumerates the allocation flags of shared memory, which can be combined.
+ *
+ */
+enum BufferAllocFlag {
+    /** Default allocation */
+    BUFFER_ALLOC_FLAG_NONE = 0,
+    /** Huge pages back buffers of the {@link BUFFER_CONSUMER_USAGE_SORTWARE} usage, to reduce TLB misses of large
+     *  frames. The buffers are only accessible in the process of the consumer. */
+    BUFFER_ALLOC_FLAG_HUGE_PAGE = 1 << 0,
+    /** The base address and the stride are aligned to 64 bytes, so that SIMD code uses aligned loads on
+     *  every row. For YUV formats, the stride of the luma plane is aligned. */
+    BUFFER_ALLOC_FLAG_ALIGN_64 = 1 << 1,
+    /** Mask of all valid flags */
+    BUFFER_ALLOC_FLAG_MASK = BUFFER_ALLOC_FLAG_HUGE_PAGE | BUFFER_ALLOC_FLAG_ALIGN_64
+};
+
+/**
+ * @brief Enumerates the CPU access modes of shared memory, used to decide the cache maintenance of cached usages.
+ *
+ */
+enum CpuAccessMode {
+    /** CPU reads the memory. The cache of the range is invalidated when the access begins. */
+    CPU_ACCESS_READ = 1,
+    /** CPU writes the memory. The cache of the range is flushed when the access ends. */
+    CPU_ACCESS_WRITE = 2,
+    /** CPU reads and writes the memory. */
+    CPU_ACCESS_READ_WRITE = CPU_ACCESS_READ | CPU_ACCESS_WRITE
+};
+/**
+ * @brief Enumerates the fields of {@link FrameMetadata}, which can be combined to mark the fields set.
+ *
+ */
+enum FrameMetadataField {
+    /** Capture timestamp */
+    FRAME_METADATA_CAPTURE_TIMESTAMP = 1 << 0,
+    /** Presentation timestamp */
+    FRAME_METADATA_PRESENT_TIMESTAMP = 1 << 1,
+    /** Frame sequence number */
+    FRAME_METADATA_SEQUENCE = 1 << 2,
+    /** Crop rectangle */
+    FRAME_METADATA_CROP = 1 << 3,
+    /** Transform */
+    FRAME_METADATA_TRANSFORM = 1 << 4,
+    /** Color space and range */
+    FRAME_METADATA_COLOR = 1 << 5,
+    /** HDR static metadata */
+    FRAME_METADATA_HDR = 1 << 6,
+    /** Mask of all valid fields */
+    FRAME_METADATA_MASK = (1 << 7) - 1
+};
+
+/**
+ * @brief Enumerates the transforms applied to a frame when it is displayed.
+ *
+ */
+enum FrameTransform {
+    /** No transform */
+    FRAME_TRANSFORM_NONE = 0,
+    /** Rotation by 90 degrees clockwise */
+    FRAME_TRANSFORM_ROTATE_90,
+    /** Rotation by 180 degrees */
+    FRAME_TRANSFORM_ROTATE_180,
+    /** Rotation by 270 degrees clockwise */
+    FRAME_TRANSFORM_ROTATE_270,
+    /** Horizontal flip */
+    FRAME_TRANSFORM_FLIP_H,
+    /** Vertical flip */
+    FRAME_TRANSFORM_FLIP_V,
+    /** Valid maximum value */
+    FRAME_TRANSFORM_MAX
+};
+
+/**
+ * @brief Enumerates the color spaces of a frame.
+ *
+ */
+enum FrameColorSpace {
+    /** Unknown color space */
+    FRAME_COLOR_SPACE_UNKNOWN = 0,
+    /** sRGB */
+    FRAME_COLOR_SPACE_SRGB,
+    /** Display P3 */
+    FRAME_COLOR_SPACE_DISPLAY_P3,
+    /** ITU-R BT.601 */
+    FRAME_COLOR_SPACE_BT601,
+    /** ITU-R BT.709 */
+    FRAME_COLOR_SPACE_BT709,
+    /** ITU-R BT.2020 */
+    FRAME_COLOR_SPACE_BT2020,
+    /** Valid maximum value */
+    FRAME_COLOR_SPACE_MAX
+};
+
+/**
+ * @brief Enumerates the color ranges of a frame.
+ *
+ */
+enum FrameColorRange {
+    /** Unknown color range */
+    FRAME_COLOR_RANGE_UNKNOWN = 0,
+    /** Limited range, for example, 16 to 235 for 8-bit luma */
+    FRAME_COLOR_RANGE_LIMITED,
+    /** Full range */
+    FRAME_COLOR_RANGE_FULL,
+    /** Valid maximum value */
+    FRAME_COLOR_RANGE_MAX
+};
+
+/**
+ * @brief Enumerates the transfer functions of HDR frames.
+ *
+ */
+enum FrameHdrTransfer {
+    /** Standard dynamic range */
+    FRAME_HDR_TRANSFER_SDR = 0,
+    /** SMPTE ST 2084, perceptual quantizer */
+    FRAME_HDR_TRANSFER_PQ,
+    /** ARIB STD-B67, hybrid log-gamma */
+    FRAME_HDR_TRANSFER_HLG,
+    /** Valid maximum value */
+    FRAME_HDR_TRANSFER_MAX
+};
+
+/**
+ * @brief Defines the HDR static metadata of a frame, as SMPTE ST 2086 and CTA-861.3 define.
+ *
+ */
+struct FrameHdrMetadata {
+    /** Chromaticity of the red, green and blue display primaries, x then y, in units of 0.00002 */
+    uint16_t displayPrimaries[3][2];
+    /** Chromaticity of the white point, x then y, in units of 0.00002 */
+    uint16_t whitePoint[2];
+    /** Maximum display mastering luminance, in units of 1 cd/m2 */
+    uint32_t maxLuminance;
+    /** Minimum display mastering luminance, in units of 0.0001 cd/m2 */
+    uint32_t minLuminance;
+    /** Maximum content light level, in units of 1 cd/m2 */
+    uint16_t maxContentLightLevel;
+    /** Maximum frame-average light level, in units of 1 cd/m2 */
+    uint16_t maxFrameAverageLightLevel;
+    /** Transfer function. For details, see {@link FrameHdrTransfer}. */
+    uint8_t transfer;
+    /** Reserved, set to <b>0</b> */
+    uint8_t reserved[3];
+};
+
+/**
+ * @brief Defines the standard metadata of a frame, transferred with shared memory from producers to consumers.
+ *
+ * All fields have a fixed width, so the metadata is transferred across processes as one block. Only the fields
+ * marked in <b>fields</b> are valid.
+ *
+ */
+struct FrameMetadata {
+    /** Fields set. For details, see {@link FrameMetadataField}. */
+    uint32_t fields;
+    /** Transform. For details, see {@link FrameTransform}. */
+    uint32_t transform;
+    /** Time when the frame is captured, in nanoseconds of the monotonic clock */
+    int64_t captureTimestamp;
+    /** Time when the frame is to be presented, in nanoseconds of the monotonic clock */
+    int64_t presentTimestamp;
+    /** Sequence number of the frame */
+    uint64_t sequence;
+    /** X coordinate of the top left corner of the crop rectangle, in pixels */
+    int32_t cropX;
+    /** Y coordinate of the top left corner of the crop rectangle, in pixels */
+    int32_t cropY;
+    /** Width of the crop rectangle, in pixels */
+    uint32_t cropWidth;
+    /** Height of the crop rectangle, in pixels */
+    uint32_t cropHeight;
+    /** Color space. For details, see {@link FrameColorSpace}. */
+    uint8_t colorSpace;
+    /** Color range. For details, see {@link FrameColorRange}. */
+    uint8_t colorRange;
+    /** Reserved, set to <b>0</b> */
+    uint8_t reserved[2];
+    /** HDR static metadata */
+    FrameHdrMetadata hdr;
+};
 } // end namespace OHOS
 #endif
@@ -15,10 +15,16 @@
 
 #include <climits>
 #include <gtest/gtest.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "buffer_common.h"
+#include "buffer_manager.h"
+#include "buffer_queue.h"
 #include "surface.h"
 #include "surface_impl.h"
+#include "surface_set.h"
 
 using namespace std;
 using namespace testing::ext;
@@ -41,6 +47,64 @@ void BufferConsumerTest::OnBufferAvailable()
 {
 }
 
+static bool IsReadable(int32_t fd)
+{
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+class SlowAllocator : public AnonymousAllocator {
+public:
+    explicit SlowAllocator(uint32_t delay) : delay_(delay) {}
+    ~SlowAllocator() override {}
+    int32_t AllocMem(const AllocInfo& info, BufferHandle** handle) override
+    {
+        usleep(delay_);
+        return AnonymousAllocator::AllocMem(info, handle);
+    }
+
+private:
+    uint32_t delay_;
+};
+
+class CountingAllocator : public AnonymousAllocator {
+public:
+    CountingAllocator() : allocCount_(0) {}
+    ~CountingAllocator() override {}
+    int32_t AllocMem(const AllocInfo& info, BufferHandle** handle) override
+    {
+        allocCount_++;
+        return AnonymousAllocator::AllocMem(info, handle);
+    }
+    uint32_t GetAllocCount() const
+    {
+        return allocCount_;
+    }
+
+private:
+    uint32_t allocCount_;
+};
+
+static void* AllocFreeBuffers(void* arg)
+{
+    const uint32_t liveBufferNum = 32; // 8 threads keep 256 shared memory segments, within the system limit
+    const uint32_t loopNum = 128;
+    SurfaceBufferImpl* buffers[liveBufferNum] = { nullptr };
+    BufferManager* manager = BufferManager::GetInstance();
+    intptr_t failed = 0;
+    for (uint32_t loop = 0; loop < loopNum; loop++) {
+        for (uint32_t i = 0; i < liveBufferNum; i++) {
+            buffers[i] = manager->AllocBuffer(64 + (i % 4) * 64, BUFFER_CONSUMER_USAGE_SORTWARE); // 64B ~ 256B
+            failed += (buffers[i] == nullptr) ? 1 : 0;
+        }
+        for (uint32_t i = 0; i < liveBufferNum; i++) {
+            manager->FreeBuffer(&buffers[i]);
+            failed += (buffers[i] != nullptr) ? 1 : 0;
+        }
+    }
+    return reinterpret_cast<void*>(failed);
+}
+
 void SurfaceTest::SetUpTestCase(void)
 {
 }
@@ -183,6 +247,260 @@ HWTEST_F(SurfaceTest, surface_buffer_003, TestSize.Level1)
     EXPECT_EQ(value64, aValue64);
 }
 
+/*
+ * Feature: Surface
+ * Function: Surface Buffer cpu access
+ * SubFunction: NA
+ * FunctionPoints: Surface Buffer begin and end cpu access of a byte range.
+ * EnvConditions: NA
+ * CaseDescription: Verify the Surface Buffer cpu access range and state.
+ */
+HWTEST_F(SurfaceTest, surface_buffer_004, TestSize.Level1)
+{
+    Surface* surface = Surface::CreateSurface();
+    ASSERT_TRUE(surface);
+    surface->SetUsage(BUFFER_CONSUMER_USAGE_HARDWARE_CONSUMER_CACHE);
+    surface->SetSize(4096); // Set alloc 4096B
+    SurfaceBuffer* buffer = surface->RequestBuffer(1);
+    ASSERT_TRUE(buffer);
+
+    EXPECT_NE(0, buffer->BeginCpuAccess(0, 0, CPU_ACCESS_WRITE));
+    EXPECT_NE(0, buffer->BeginCpuAccess(4000, 100, CPU_ACCESS_WRITE));
+    EXPECT_NE(0, buffer->BeginCpuAccess(0, 100, 0));
+    EXPECT_NE(0, buffer->EndCpuAccess());
+
+    EXPECT_EQ(0, buffer->BeginCpuAccess(100, 200, CPU_ACCESS_READ_WRITE));
+    EXPECT_NE(0, buffer->BeginCpuAccess(0, 100, CPU_ACCESS_READ)); // already in progress.
+    EXPECT_EQ(0, buffer->EndCpuAccess());
+    EXPECT_TRUE(reinterpret_cast<SurfaceBufferImpl*>(buffer)->IsCpuCacheFlushed());
+    EXPECT_NE(0, buffer->EndCpuAccess());
+    EXPECT_EQ(0, surface->FlushBuffer(buffer));
+
+    SurfaceBuffer* acquireBuffer = surface->AcquireBuffer();
+    ASSERT_TRUE(acquireBuffer);
+    EXPECT_EQ(0, acquireBuffer->BeginCpuAccess(0, 4096, CPU_ACCESS_READ));
+    EXPECT_EQ(0, acquireBuffer->EndCpuAccess());
+    EXPECT_TRUE(surface->ReleaseBuffer(acquireBuffer));
+
+    buffer = surface->RequestBuffer(1);
+    ASSERT_TRUE(buffer);
+    EXPECT_FALSE(reinterpret_cast<SurfaceBufferImpl*>(buffer)->IsCpuCacheFlushed());
+    surface->CancelBuffer(buffer);
+    delete surface;
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface Buffer extra data storage
+ * SubFunction: NA
+ * FunctionPoints: extra data is kept in place and overflows to map.
+ * EnvConditions: NA
+ * CaseDescription: Surface buffer keeps values of many keys in any order, and moves them to another buffer.
+ */
+HWTEST_F(SurfaceTest, surface_buffer_005, TestSize.Level1)
+{
+    const int32_t keyCount = 40; // more than keys kept in place
+    SurfaceBufferImpl buffer;
+    for (int32_t i = keyCount - 1; i >= 0; i--) {
+        EXPECT_EQ(0, buffer.SetInt32(i * 3, i)); // 3: keys are set in descending and sparse order
+    }
+    EXPECT_EQ(0, buffer.SetInt64(0, 0x123456789)); // overwrite with another type
+    for (int32_t i = 1; i < keyCount; i++) {
+        int32_t value = -1;
+        EXPECT_EQ(0, buffer.GetInt32(i * 3, value)); // 3: keys are set in sparse order
+        EXPECT_EQ(i, value);
+    }
+    int32_t value32 = -1;
+    EXPECT_NE(0, buffer.GetInt32(0, value32)); // type changed to int64
+    EXPECT_NE(0, buffer.GetInt32(1, value32)); // key is not set
+    int64_t value64 = -1;
+    EXPECT_EQ(0, buffer.GetInt64(0, value64));
+    EXPECT_EQ(0x123456789, value64);
+
+    SurfaceBufferImpl target;
+    target.MoveExtraData(buffer);
+    EXPECT_NE(0, buffer.GetInt64(0, value64)); // moved to target
+    EXPECT_EQ(0, target.GetInt32((keyCount - 1) * 3, value32)); // 3: keys are set in sparse order
+    EXPECT_EQ(keyCount - 1, value32);
+    target.ClearExtraData();
+    EXPECT_NE(0, target.GetInt32(3, value32)); // 3: first key of int32
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface Buffer blob extra data
+ * SubFunction: NA
+ * FunctionPoints: blob extra data is copied to pooled storage and moved with the buffer.
+ * EnvConditions: NA
+ * CaseDescription: Surface buffer sets, gets, overwrites, moves, clears and receives blobs of small and large size.
+ */
+HWTEST_F(SurfaceTest, surface_buffer_006, TestSize.Level1)
+{
+    const uint32_t largeSize = 4096; // larger than blobs passed in ipc object
+    uint8_t large[largeSize];
+    for (uint32_t i = 0; i < largeSize; i++) {
+        large[i] = static_cast<uint8_t>(i);
+    }
+    uint8_t small[] = {1, 2, 3};
+    SurfaceBufferImpl buffer;
+    EXPECT_EQ(0, buffer.SetBlob(1, small, sizeof(small)));
+    EXPECT_EQ(0, buffer.SetBlob(2, large, largeSize));
+    EXPECT_NE(0, buffer.SetBlob(3, large, 0)); // empty blob
+    EXPECT_NE(0, buffer.SetBlob(3, large, SURFACE_MAX_BLOB_SIZE + 1));
+    EXPECT_NE(0, buffer.SetBlob(3, nullptr, 1));
+
+    const void* data = nullptr;
+    uint32_t size = 0;
+    EXPECT_EQ(0, buffer.GetBlob(2, data, size));
+    ASSERT_EQ(largeSize, size);
+    EXPECT_EQ(large[largeSize - 1], static_cast<const uint8_t*>(data)[largeSize - 1]);
+    EXPECT_EQ(0, buffer.SetBlob(2, small, sizeof(small))); // overwrite in place
+    EXPECT_EQ(0, buffer.GetBlob(2, data, size));
+    EXPECT_EQ(sizeof(small), size);
+    EXPECT_EQ(small[2], static_cast<const uint8_t*>(data)[2]);
+    EXPECT_EQ(0, buffer.SetInt32(1, 1)); // overwrite with another type
+    int32_t value = 0;
+    EXPECT_NE(0, buffer.GetBlob(1, data, size));
+    EXPECT_NE(0, buffer.GetInt32(2, value));
+
+    SurfaceBufferImpl target;
+    target.MoveExtraData(buffer);
+    EXPECT_NE(0, buffer.GetBlob(2, data, size)); // moved to target
+    EXPECT_EQ(0, target.GetBlob(2, data, size));
+    EXPECT_EQ(small[0], static_cast<const uint8_t*>(data)[0]);
+    target.ClearExtraData();
+    EXPECT_NE(0, target.GetBlob(2, data, size));
+
+    int32_t fds[2] = {-1, -1};
+    ASSERT_EQ(0, pipe(fds));
+    const size_t ipcSize = 256;
+    uint8_t ipcData[ipcSize];
+    IpcIo io;
+    IpcIoInit(&io, ipcData, ipcSize, 1); // 1: one fd
+    WriteUint64(&io, 0); // no base version
+    WriteUint64(&io, 0); // no version
+    WriteUint32(&io, 1); // one key
+    WriteUint32(&io, 3); // key 3
+    WriteUint32(&io, BUFFER_DATA_TYPE_BLOB);
+    WriteUint32(&io, largeSize);
+    WriteBool(&io, true); // passed by shared memory
+    WriteFileDescriptor(&io, fds[0]); // a pipe, which could not be read as shared memory
+    WriteUint32(&io, 0); // no frame metadata
+    IpcIo readIo;
+    IpcIoInit(&readIo, ipcData, ipcSize - io.bufferLeft, 1); // 1: one fd
+    EXPECT_EQ(0, target.ReadExtraDataFromIpcIo(readIo));
+    EXPECT_NE(0, target.GetBlob(3, data, size)); // blob failed to read is not exposed
+    close(fds[0]);
+    close(fds[1]);
+
+    const uint32_t copiedSize = 64; // larger than BLOB_IPC_INLINE_SIZE
+    IpcIoInit(&io, ipcData, ipcSize, 0);
+    WriteUint64(&io, 0); // no base version
+    WriteUint64(&io, 0); // no version
+    WriteUint32(&io, 1); // one key
+    WriteUint32(&io, 4); // key 4
+    WriteUint32(&io, BUFFER_DATA_TYPE_BLOB);
+    WriteUint32(&io, copiedSize);
+    WriteBool(&io, false); // copied by the sender without shared memory
+    WriteBuffer(&io, large, copiedSize);
+    WriteUint32(&io, 0); // no frame metadata
+    IpcIoInit(&readIo, ipcData, ipcSize - io.bufferLeft, 0);
+    EXPECT_EQ(0, target.ReadExtraDataFromIpcIo(readIo));
+    EXPECT_EQ(0, target.GetBlob(4, data, size));
+    ASSERT_EQ(copiedSize, size);
+    EXPECT_EQ(large[copiedSize - 1], static_cast<const uint8_t*>(data)[copiedSize - 1]);
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface Buffer extra data delta
+ * SubFunction: NA
+ * FunctionPoints: only the extra data changed since the last delta is written to ipc object.
+ * EnvConditions: NA
+ * CaseDescription: Receiver rebuilds all keys from the delta, and rejects the delta without the baseline.
+ */
+HWTEST_F(SurfaceTest, surface_buffer_007, TestSize.Level1)
+{
+    const int32_t keyCount = 12; // keys set every frame
+    const size_t ipcSize = 1024;
+    uint8_t data[ipcSize];
+    size_t sizes[2] = {0};
+    SurfaceBufferImpl sender;
+    SurfaceBufferImpl receiver;
+    for (int32_t frame = 0; frame < 2; frame++) { // 2: the second frame changes one key and removes one
+        for (int32_t i = 0; i < keyCount - frame; i++) {
+            EXPECT_EQ(0, sender.SetInt64(i, (i == 0) ? frame : i));
+        }
+        IpcIo io;
+        IpcIoInit(&io, data, ipcSize, 0);
+        sender.WriteToIpcIo(io, true);
+        sizes[frame] = ipcSize - io.bufferLeft;
+        IpcIo readIo;
+        IpcIoInit(&readIo, data, sizes[frame], 0);
+        receiver.ReadAttrFromIpcIo(readIo);
+        EXPECT_EQ(0, receiver.ReadExtraDataFromIpcIo(readIo));
+        sender.ClearExtraData();
+    }
+    EXPECT_LT(sizes[1], sizes[0]);
+    int64_t value = -1;
+    EXPECT_EQ(0, receiver.GetInt64(0, value));
+    EXPECT_EQ(1, value);
+    EXPECT_EQ(0, receiver.GetInt64(keyCount - 2, value)); // 2: last key kept
+    EXPECT_EQ(keyCount - 2, value);
+    EXPECT_NE(0, receiver.GetInt64(keyCount - 1, value)); // removed in the second frame
+
+    IpcIo io;
+    IpcIoInit(&io, data, ipcSize, 0);
+    sender.WriteToIpcIo(io, true);
+    IpcIo readIo;
+    IpcIoInit(&readIo, data, ipcSize - io.bufferLeft, 0);
+    SurfaceBufferImpl other;
+    other.ReadAttrFromIpcIo(readIo);
+    EXPECT_EQ(SURFACE_ERROR_DATA_STALE, other.ReadExtraDataFromIpcIo(readIo));
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface Buffer wire data
+ * SubFunction: NA
+ * FunctionPoints: buffer attr is written to ipc object in one versioned block.
+ * EnvConditions: NA
+ * CaseDescription: Receiver gets the stride, reserved values and planes of buffer, truncated block is rejected.
+ */
+HWTEST_F(SurfaceTest, surface_buffer_008, TestSize.Level1)
+{
+    const int32_t reserve[] = {3, 5, 7}; // 1 fd value and 2 integer values
+    PlaneInfo plane = {128, 0, 1280};
+    SurfaceBufferImpl sender;
+    sender.SetKey(1);
+    sender.SetStride(128);
+    sender.SetMaxSize(1280);
+    EXPECT_EQ(0, sender.SetReserve(reserve, 1, 2));
+    EXPECT_NE(0, sender.SetReserve(reserve, BUFFER_RESERVE_MAX_NUM, 1));
+    EXPECT_EQ(0, sender.SetPlanes(&plane, 1));
+
+    const size_t ipcSize = 1024;
+    uint8_t data[ipcSize];
+    IpcIo io;
+    IpcIoInit(&io, data, ipcSize, 0);
+    sender.WriteToIpcIo(io);
+    size_t size = ipcSize - io.bufferLeft;
+    IpcIo readIo;
+    IpcIoInit(&readIo, data, size, 0);
+    SurfaceBufferImpl receiver;
+    EXPECT_TRUE(receiver.ReadFromIpcIo(readIo));
+    EXPECT_EQ(1, receiver.GetKey());
+    EXPECT_EQ(128, receiver.GetStride());
+    EXPECT_EQ(1u, receiver.GetReserveFds());
+    EXPECT_EQ(2u, receiver.GetReserveInts());
+    EXPECT_EQ(7, receiver.GetReserve()[2]);
+    EXPECT_EQ(1, receiver.GetPlaneCount());
+
+    IpcIoInit(&readIo, data, 16, 0); // 16: shorter than buffer attr
+    SurfaceBufferImpl truncated;
+    EXPECT_FALSE(truncated.ReadAttrFromIpcIo(readIo));
+}
+
 /*
  * Feature: Surface
  * Function: Surface set width and height
@@ -332,7 +650,7 @@ HWTEST_F(SurfaceTest, surface_set_003, TestSize.Level1)
     EXPECT_EQ(4, surface->GetStrideAlignment()); // default format stride alignment is 4
 
     surface->SetWidthAndHeight(99, 90);
-    SurfaceBuffer* bufferFirst = surface->RequestBuffer();
+    SurfaceBuffer* bufferFirst = surface->RequestBuffer(1);
     EXPECT_EQ(208, surface->GetStride());
     surface->CancelBuffer(bufferFirst);
 
@@ -576,7 +894,7 @@ HWTEST_F(SurfaceTest, surface_001, TestSize.Level1)
     EXPECT_EQ(202, surface->GetHeight());
     EXPECT_EQ(102, surface->GetFormat());
     EXPECT_EQ(8, surface->GetStrideAlignment());
-    SurfaceBuffer* bufferFirst = surface->RequestBuffer();
+    SurfaceBuffer* bufferFirst = surface->RequestBuffer(1);
     EXPECT_EQ(208, surface->GetStride()); // calculate by width, height, format.
     EXPECT_EQ(42016, surface->GetSize()); // calculate by width, height, format.
     surface->CancelBuffer(bufferFirst);
@@ -605,14 +923,14 @@ HWTEST_F(SurfaceTest, surface_002, TestSize.Level1)
     EXPECT_FALSE(bufferFirst);
 
     surface->SetSize(1024); // Set alloc 1024B SHM
-    bufferFirst = surface->RequestBuffer();
+    bufferFirst = surface->RequestBuffer(1);
     EXPECT_TRUE(bufferFirst);
 
     SurfaceBuffer* bufferSecond = surface->RequestBuffer(); // default queue size = 1, second return null pointer
 
     EXPECT_FALSE(bufferSecond);
     surface->CancelBuffer(bufferFirst);
-    EXPECT_TRUE(surface->RequestBuffer());
+    EXPECT_TRUE(surface->RequestBuffer(1));
 
     delete surface;
 }
@@ -634,7 +952,7 @@ HWTEST_F(SurfaceTest, surface_003, TestSize.Level1)
     EXPECT_FALSE(requestBuffer);
 
     surface->SetWidthAndHeight(454, 454); // 454 : surface width and height
-    requestBuffer = surface->RequestBuffer();
+    requestBuffer = surface->RequestBuffer(1);
     EXPECT_TRUE(requestBuffer);
 
     SurfaceBufferImpl* buffer = new SurfaceBufferImpl();
@@ -662,7 +980,7 @@ HWTEST_F(SurfaceTest, surface_004, TestSize.Level1)
     EXPECT_FALSE(acquireBuffer);
 
     surface->SetSize(1024); // Set alloc 1024B SHM
-    SurfaceBuffer* requestBuffer = surface->RequestBuffer();
+    SurfaceBuffer* requestBuffer = surface->RequestBuffer(1);
     if (requestBuffer == nullptr) {
         delete surface;
         return;
@@ -700,7 +1018,7 @@ HWTEST_F(SurfaceTest, surface_005, TestSize.Level1)
     EXPECT_FALSE(acquireBuffer);
 
     surface->SetSize(1024); // Set alloc 1024B SHM
-    SurfaceBuffer* requestBuffer = surface->RequestBuffer();
+    SurfaceBuffer* requestBuffer = surface->RequestBuffer(1);
     if (requestBuffer == nullptr) {
         delete buffer;
         delete surface;
@@ -756,7 +1074,7 @@ HWTEST_F(SurfaceTest, surface_006, TestSize.Level1)
     EXPECT_FALSE(acquireBuffer);
 
     surface->SetSize(1024); // Set alloc 1024B SHM
-    SurfaceBuffer* requestBuffer = surface->RequestBuffer();
+    SurfaceBuffer* requestBuffer = surface->RequestBuffer(1);
     if (requestBuffer == nullptr) {
         delete buffer;
         buffer = nullptr;
@@ -793,4 +1111,1023 @@ HWTEST_F(SurfaceTest, surface_006, TestSize.Level1)
     delete surface;
     delete consumerListener;
 }
+
+/*
+ * Feature: Surface
+ * Function: Surface single process detach and attach Buffer
+ * SubFunction: NA
+ * FunctionPoints: buffer detach and attach between surfaces
+ * EnvConditions: NA
+ * CaseDescription: Surface single process move buffer to other surface without copy, and free detached buffer.
+ */
+HWTEST_F(SurfaceTest, surface_007, TestSize.Level1)
+{
+    Surface* camera = Surface::CreateSurface();
+    ASSERT_TRUE(camera);
+    Surface* preview = Surface::CreateSurface();
+    if (preview == nullptr) {
+        delete camera;
+        return;
+    }
+    camera->SetSize(1024); // Set alloc 1024B SHM
+    preview->SetSize(1024); // Set alloc 1024B SHM
+
+    SurfaceBuffer* requestBuffer = camera->RequestBuffer(1);
+    ASSERT_TRUE(requestBuffer);
+    requestBuffer->SetInt32(10, 11); // set key-value <10, 11>
+    EXPECT_EQ(0, camera->FlushBuffer(requestBuffer));
+    SurfaceBuffer* acquireBuffer = camera->AcquireBuffer();
+    ASSERT_TRUE(acquireBuffer);
+
+    SurfaceBufferImpl* buffer = new SurfaceBufferImpl();
+    EXPECT_TRUE(camera->DetachBuffer(buffer) != 0); // Not allocated by surface, could not detach.
+    EXPECT_EQ(0, camera->DetachBuffer(acquireBuffer));
+    EXPECT_FALSE(camera->ReleaseBuffer(acquireBuffer)); // Detached, not in camera any more.
+    SurfaceBuffer* newBuffer = camera->RequestBuffer(1); // queue size = 1, could alloc a new one.
+    EXPECT_TRUE(newBuffer);
+
+    EXPECT_EQ(0, preview->AttachBuffer(acquireBuffer, true));
+    EXPECT_EQ(acquireBuffer, preview->AcquireBuffer());
+    int32_t value;
+    EXPECT_EQ(0, acquireBuffer->GetInt32(10, value));
+    EXPECT_EQ(11, value);
+    EXPECT_TRUE(preview->ReleaseBuffer(acquireBuffer));
+    EXPECT_EQ(acquireBuffer, preview->RequestBuffer(1)); // Attached buffer is reused, no more alloc.
+
+    EXPECT_EQ(0, camera->DetachBuffer(newBuffer));
+    EXPECT_TRUE(preview->AttachBuffer(newBuffer, false) != 0); // preview queue is full.
+    Surface* large = Surface::CreateSurface();
+    ASSERT_TRUE(large);
+    large->SetSize(4096); // Set alloc 4096B SHM
+    EXPECT_TRUE(large->AttachBuffer(newBuffer, false) != 0); // 1024B buffer is smaller than the queue.
+    large->SetSize(1024); // Set alloc 1024B SHM
+    large->SetUsage(BUFFER_CONSUMER_USAGE_HARDWARE);
+    EXPECT_TRUE(large->AttachBuffer(newBuffer, false) != 0); // usage differs.
+    delete large;
+    EXPECT_EQ(0, camera->AttachBuffer(newBuffer, false));
+    EXPECT_EQ(newBuffer, camera->RequestBuffer(1));
+    camera->SetSize(2048); // newBuffer is delete pending
+    EXPECT_EQ(0, camera->DetachBuffer(newBuffer));
+    EXPECT_TRUE(camera->AttachBuffer(newBuffer, false) != 0); // stale attributes, not attached again.
+
+    BufferManager* manager = BufferManager::GetInstance();
+    ASSERT_TRUE(manager);
+    manager->FlushDeferredFree();
+    manager->TrimCache();
+    uint64_t usage = manager->GetMemoryUsage();
+    EXPECT_TRUE(camera->FreeDetachedBuffer(acquireBuffer) != 0); // attached to preview, could not free.
+    EXPECT_EQ(0, camera->FreeDetachedBuffer(newBuffer)); // detached and never attached again.
+    manager->TrimCache();
+    EXPECT_EQ(usage - 1024, manager->GetMemoryUsage());
+
+    delete buffer;
+    delete preview;
+    delete camera;
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface acquire and request event fd
+ * SubFunction: NA
+ * FunctionPoints: event fd readiness follows dirty queue and free queue
+ * EnvConditions: NA
+ * CaseDescription: Surface event fd is readable only when buffer could be acquired or requested.
+ */
+HWTEST_F(SurfaceTest, surface_008, TestSize.Level1)
+{
+    Surface* surface = Surface::CreateSurface();
+    ASSERT_TRUE(surface);
+
+    int32_t acquireFd = surface->GetAcquireEventFd();
+    int32_t requestFd = surface->GetRequestEventFd();
+    ASSERT_GE(acquireFd, 0);
+    ASSERT_GE(requestFd, 0);
+    EXPECT_EQ(acquireFd, surface->GetAcquireEventFd());
+    EXPECT_FALSE(IsReadable(acquireFd));
+    EXPECT_FALSE(IsReadable(requestFd)); // no size, could not request.
+
+    surface->SetSize(1024); // Set alloc 1024B SHM
+    EXPECT_TRUE(IsReadable(requestFd));
+    SurfaceBuffer* requestBuffer = surface->RequestBuffer(1);
+    ASSERT_TRUE(requestBuffer);
+    EXPECT_FALSE(IsReadable(requestFd)); // default queue size = 1, no more buffer.
+
+    EXPECT_EQ(0, surface->FlushBuffer(requestBuffer));
+    EXPECT_TRUE(IsReadable(acquireFd));
+    EXPECT_TRUE(IsReadable(acquireFd)); // level triggered, still readable.
+
+    SurfaceBuffer* acquireBuffer = surface->AcquireBuffer();
+    ASSERT_TRUE(acquireBuffer);
+    EXPECT_FALSE(IsReadable(acquireFd));
+    EXPECT_TRUE(surface->ReleaseBuffer(acquireBuffer));
+    EXPECT_TRUE(IsReadable(requestFd));
+
+    delete surface;
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface background allocation
+ * SubFunction: NA
+ * FunctionPoints: buffers are allocated by background worker to the queue size.
+ * EnvConditions: NA
+ * CaseDescription: Surface request buffers which are allocated by the worker after the first request.
+ */
+HWTEST_F(SurfaceTest, surface_009, TestSize.Level1)
+{
+    Surface* surface = Surface::CreateSurface();
+    ASSERT_TRUE(surface);
+    surface->SetQueueSize(3); // 3 buffers
+    surface->SetSize(1024); // Set alloc 1024B SHM
+
+    SurfaceBuffer* buffers[3] = { nullptr };
+    EXPECT_EQ(nullptr, surface->RequestBuffer(0)); // no wait, only starts the worker.
+    for (int32_t i = 0; i < 3; i++) {
+        buffers[i] = surface->RequestBuffer(1); // wait for the worker.
+        ASSERT_TRUE(buffers[i]);
+        if (i > 0) {
+            EXPECT_NE(buffers[i - 1], buffers[i]);
+        }
+    }
+    EXPECT_EQ(nullptr, surface->RequestBuffer(0)); // queue is full.
+    for (int32_t i = 0; i < 3; i++) {
+        surface->CancelBuffer(buffers[i]);
+    }
+    delete surface;
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface deferred buffer free
+ * SubFunction: NA
+ * FunctionPoints: buffers dropped by reset are freed out of the queue lock.
+ * EnvConditions: NA
+ * CaseDescription: Surface resize frees the old buffer on the worker, flush deferred free waits for it.
+ */
+HWTEST_F(SurfaceTest, surface_010, TestSize.Level1)
+{
+    BufferManager* manager = BufferManager::GetInstance();
+    ASSERT_TRUE(manager);
+    Surface* surface = Surface::CreateSurface();
+    ASSERT_TRUE(surface);
+    manager->FlushDeferredFree();
+    manager->TrimCache();
+
+    surface->SetSize(1024); // Set alloc 1024B SHM
+    SurfaceBuffer* buffer = surface->RequestBuffer(1);
+    ASSERT_TRUE(buffer);
+    surface->CancelBuffer(buffer);
+    surface->SetSize(2048); // Reset, the 1024B buffer is deferred to free.
+    manager->FlushDeferredFree();
+    EXPECT_EQ(1024, manager->GetCacheStats().cachedBytes); // freed to the recycling cache.
+
+    delete surface;
+    manager->FlushDeferredFree();
+    manager->TrimCache();
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface memory budget
+ * SubFunction: NA
+ * FunctionPoints: idle free buffers of all surfaces are trimmed to meet the memory budget.
+ * EnvConditions: NA
+ * CaseDescription: Surface request exceeding the budget trims the least recently used idle buffer, or fails.
+ */
+HWTEST_F(SurfaceTest, surface_011, TestSize.Level1)
+{
+    BufferManager* manager = BufferManager::GetInstance();
+    ASSERT_TRUE(manager);
+    manager->FlushDeferredFree();
+    manager->TrimCache();
+    uint64_t base = manager->GetMemoryUsage();
+    manager->SetMemoryBudget(base + 2048); // 2048B, two 1024B buffers at most.
+
+    Surface* surfaces[3] = { nullptr };
+    for (int32_t i = 0; i < 3; i++) {
+        surfaces[i] = Surface::CreateSurface();
+        ASSERT_TRUE(surfaces[i]);
+        surfaces[i]->SetSize(1024); // Set alloc 1024B SHM
+    }
+    int32_t requestFd = surfaces[0]->GetRequestEventFd();
+    for (int32_t i = 0; i < 2; i++) {
+        SurfaceBuffer* buffer = surfaces[i]->RequestBuffer(1);
+        ASSERT_TRUE(buffer);
+        surfaces[i]->CancelBuffer(buffer); // idle in free list.
+    }
+    EXPECT_EQ(base + 2048, manager->GetMemoryUsage());
+
+    SurfaceBuffer* buffer = surfaces[2]->RequestBuffer(1); // trims idle buffer of surfaces[0].
+    ASSERT_TRUE(buffer);
+    EXPECT_EQ(base + 2048, manager->GetMemoryUsage());
+    EXPECT_TRUE(IsReadable(requestFd)); // could attach again.
+
+    manager->SetMemoryBudget(base + 1024);
+    SurfaceBuffer* other = surfaces[1]->RequestBuffer(1);
+    ASSERT_TRUE(other);
+    EXPECT_EQ(nullptr, surfaces[0]->RequestBuffer(0)); // no idle buffer to trim.
+    surfaces[1]->CancelBuffer(other);
+    surfaces[2]->CancelBuffer(buffer);
+
+    manager->SetMemoryBudget(0);
+    for (int32_t i = 0; i < 3; i++) {
+        delete surfaces[i];
+    }
+    manager->FlushDeferredFree();
+    manager->TrimCache();
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface idle policy
+ * SubFunction: NA
+ * FunctionPoints: free buffers are released down to the floor when the queue is idle.
+ * EnvConditions: NA
+ * CaseDescription: Idle trim returns free buffers above the floor to the system, and they are allocated again.
+ */
+HWTEST_F(SurfaceTest, surface_012, TestSize.Level1)
+{
+    const uint32_t idleTimeout = 60000; // 60s, trimmed explicitly below rather than by the worker
+    BufferManager* manager = BufferManager::GetInstance();
+    ASSERT_TRUE(manager);
+    BufferQueue* queue = new BufferQueue();
+    ASSERT_TRUE(queue);
+    ASSERT_TRUE(queue->Init());
+    queue->SetQueueSize(3); // 3 buffers
+    queue->SetSize(1024); // Set alloc 1024B SHM
+    EXPECT_NE(0, queue->SetIdlePolicy(idleTimeout, 4)); // floor is more than queue size.
+    EXPECT_EQ(0, queue->SetIdlePolicy(idleTimeout, 1));
+
+    SurfaceBufferImpl* buffers[3] = { nullptr };
+    for (int32_t i = 0; i < 3; i++) {
+        buffers[i] = queue->RequestBuffer(1);
+        ASSERT_TRUE(buffers[i]);
+    }
+    for (int32_t i = 0; i < 3; i++) {
+        queue->CancelBuffer(*buffers[i]);
+    }
+    manager->FlushDeferredFree();
+    manager->TrimCache();
+    uint64_t usage = manager->GetMemoryUsage();
+    EXPECT_EQ(2, queue->TrimIdle()); // two buffers are released, one is kept.
+    EXPECT_EQ(usage - 2048, manager->GetMemoryUsage());
+    EXPECT_EQ(0, manager->GetCacheStats().cachedBytes); // returned to the system, not cached.
+    EXPECT_EQ(0, queue->TrimIdle());
+
+    for (int32_t i = 0; i < 3; i++) {
+        buffers[i] = queue->RequestBuffer(1); // attached again on demand.
+        ASSERT_TRUE(buffers[i]);
+    }
+    for (int32_t i = 0; i < 3; i++) {
+        queue->CancelBuffer(*buffers[i]);
+    }
+    EXPECT_EQ(0, queue->SetIdlePolicy(0, 0));
+    delete queue;
+    manager->FlushDeferredFree();
+    manager->TrimCache();
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface allocation flags
+ * SubFunction: NA
+ * FunctionPoints: buffers are allocated with huge pages and 64 bytes alignment.
+ * EnvConditions: NA
+ * CaseDescription: Surface allocates buffers whose base address and stride are aligned to 64 bytes.
+ */
+HWTEST_F(SurfaceTest, surface_013, TestSize.Level1)
+{
+    const uintptr_t alignment = 64; // 64 bytes alignment
+    Surface* surface = Surface::CreateSurface();
+    ASSERT_TRUE(surface);
+    surface->SetStrideAlignment(48); // not power of 2, failed
+    EXPECT_EQ(4, surface->GetStrideAlignment());
+    surface->SetStrideAlignment(64);
+    EXPECT_EQ(64, surface->GetStrideAlignment());
+
+    EXPECT_NE(0, surface->SetAllocFlags(1 << 8)); // invalid flag
+    EXPECT_EQ(0, surface->SetAllocFlags(BUFFER_ALLOC_FLAG_HUGE_PAGE | BUFFER_ALLOC_FLAG_ALIGN_64));
+    EXPECT_EQ(BUFFER_ALLOC_FLAG_HUGE_PAGE | BUFFER_ALLOC_FLAG_ALIGN_64, surface->GetAllocFlags());
+    surface->SetWidthAndHeight(99, 90);
+    SurfaceBuffer* buffer = surface->RequestBuffer(1);
+    ASSERT_TRUE(buffer);
+    EXPECT_EQ(256, surface->GetStride()); // 99 pixels are allocated as 128 pixels of 2 bytes
+    ASSERT_TRUE(buffer->GetVirAddr());
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(buffer->GetVirAddr()) % alignment);
+    uint8_t* virAddr = static_cast<uint8_t*>(buffer->GetVirAddr());
+    virAddr[buffer->GetSize() - 1] = 0xFF; // last byte is writable
+    surface->CancelBuffer(buffer);
+
+    EXPECT_EQ(0, surface->SetAllocFlags(BUFFER_ALLOC_FLAG_NONE));
+    buffer = surface->RequestBuffer(1);
+    ASSERT_TRUE(buffer);
+    EXPECT_EQ(208, surface->GetStride()); // reallocated without alignment
+    surface->CancelBuffer(buffer);
+    delete surface;
+    BufferManager::GetInstance()->FlushDeferredFree();
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface buffer planes
+ * SubFunction: NA
+ * FunctionPoints: plane layouts are computed for each pixel format.
+ * EnvConditions: NA
+ * CaseDescription: Surface buffer describes the stride, offset and size of each plane of RGB and YUV formats.
+ */
+HWTEST_F(SurfaceTest, surface_014, TestSize.Level1)
+{
+    Surface* surface = Surface::CreateSurface();
+    ASSERT_TRUE(surface);
+    surface->SetWidthAndHeight(100, 10);
+    SurfaceBuffer* buffer = surface->RequestBuffer(1);
+    ASSERT_TRUE(buffer);
+    PlaneInfo plane = {0};
+    EXPECT_EQ(1, buffer->GetPlaneCount()); // RGB565 has one plane
+    EXPECT_EQ(0, buffer->GetPlane(0, plane));
+    EXPECT_EQ(208, plane.stride);
+    EXPECT_EQ(0, plane.offset);
+    EXPECT_EQ(2080, plane.size);
+    EXPECT_NE(0, buffer->GetPlane(1, plane));
+    surface->CancelBuffer(buffer);
+
+    surface->SetFormat(IMAGE_PIXEL_FORMAT_NV12);
+    buffer = surface->RequestBuffer(1);
+    ASSERT_TRUE(buffer);
+    ASSERT_EQ(2, buffer->GetPlaneCount()); // luma plane and interleaved chroma plane
+    EXPECT_EQ(0, buffer->GetPlane(1, plane));
+    EXPECT_EQ(112, plane.stride); // 100 pixels of 1 byte aligned to 16 bytes
+    EXPECT_EQ(1120, plane.offset); // after 10 rows of luma
+    EXPECT_EQ(560, plane.size); // 5 rows of chroma
+    surface->CancelBuffer(buffer);
+
+    surface->SetFormat(IMAGE_PIXEL_FORMAT_YVU420);
+    buffer = surface->RequestBuffer(1);
+    ASSERT_TRUE(buffer);
+    ASSERT_EQ(3, buffer->GetPlaneCount()); // luma plane and two chroma planes
+    EXPECT_EQ(0, buffer->GetPlane(2, plane));
+    EXPECT_EQ(56, plane.stride); // half stride of luma
+    EXPECT_EQ(1400, plane.offset); // after luma and first chroma plane
+    EXPECT_EQ(280, plane.size);
+    EXPECT_LE(plane.offset + plane.size, buffer->GetSize());
+    surface->CancelBuffer(buffer);
+
+    BufferManager* manager = BufferManager::GetInstance();
+    ASSERT_TRUE(manager);
+    EXPECT_EQ(0, manager->SetAllocator(BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE,
+        BufferAllocator::GetBuiltin(BUFFER_ALLOCATOR_ANONYMOUS)));
+    surface->SetUsage(BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE);
+    surface->SetWidthAndHeight(100, 9); // odd height, the last chroma row covers one luma row
+    surface->SetFormat(IMAGE_PIXEL_FORMAT_NV12);
+    buffer = surface->RequestBuffer(1);
+    ASSERT_TRUE(buffer);
+    ASSERT_EQ(2, buffer->GetPlaneCount());
+    EXPECT_EQ(0, buffer->GetPlane(1, plane));
+    EXPECT_EQ(1008, plane.offset); // after 9 rows of luma
+    EXPECT_EQ(560, plane.size); // 5 rows of chroma
+    EXPECT_LE(plane.offset + plane.size, buffer->GetSize());
+    surface->CancelBuffer(buffer);
+
+    surface->SetFormat(IMAGE_PIXEL_FORMAT_YUV420);
+    buffer = surface->RequestBuffer(1);
+    ASSERT_TRUE(buffer);
+    ASSERT_EQ(3, buffer->GetPlaneCount());
+    EXPECT_EQ(0, buffer->GetPlane(2, plane));
+    EXPECT_EQ(56, plane.stride);
+    EXPECT_EQ(1288, plane.offset); // after luma and 5 rows of first chroma plane
+    EXPECT_EQ(280, plane.size); // 5 rows of chroma
+    EXPECT_LE(plane.offset + plane.size, buffer->GetSize());
+    surface->CancelBuffer(buffer);
+    surface->SetUsage(BUFFER_CONSUMER_USAGE_SORTWARE);
+
+    surface->SetSize(1024); // Set alloc 1024B SHM
+    buffer = surface->RequestBuffer(1);
+    ASSERT_TRUE(buffer);
+    ASSERT_EQ(1, buffer->GetPlaneCount()); // buffer allocated by size is one plane
+    EXPECT_EQ(0, buffer->GetPlane(0, plane));
+    EXPECT_EQ(1024, plane.size);
+    surface->CancelBuffer(buffer);
+    delete surface;
+    manager->FlushDeferredFree();
+    manager->TrimCache();
+    EXPECT_EQ(0, manager->SetAllocator(BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE, nullptr));
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface buffer blob extra data
+ * SubFunction: NA
+ * FunctionPoints: blob extra data is transferred from producer to consumer.
+ * EnvConditions: NA
+ * CaseDescription: Consumer acquires the blob set by producer, the blob is freed when the buffer is released.
+ */
+HWTEST_F(SurfaceTest, surface_015, TestSize.Level1)
+{
+    Surface* surface = Surface::CreateSurface();
+    ASSERT_TRUE(surface);
+    surface->SetWidthAndHeight(100, 10);
+    const uint32_t blobSize = 4096; // a tile map of the frame
+    uint8_t blob[blobSize];
+    for (uint32_t i = 0; i < blobSize; i++) {
+        blob[i] = static_cast<uint8_t>(i * 7); // 7: any pattern
+    }
+    for (int32_t i = 0; i < 3; i++) { // 3: the pooled blob is reused by later frames
+        SurfaceBuffer* buffer = surface->RequestBuffer(1);
+        ASSERT_TRUE(buffer);
+        const void* data = nullptr;
+        uint32_t size = 0;
+        EXPECT_NE(0, buffer->GetBlob(1, data, size)); // cleared on release
+        EXPECT_EQ(0, buffer->SetBlob(1, blob, blobSize));
+        EXPECT_EQ(0, surface->FlushBuffer(buffer));
+
+        buffer = surface->AcquireBuffer();
+        ASSERT_TRUE(buffer);
+        EXPECT_EQ(0, buffer->GetBlob(1, data, size));
+        ASSERT_EQ(blobSize, size);
+        EXPECT_EQ(blob[blobSize - 1], static_cast<const uint8_t*>(data)[blobSize - 1]);
+        EXPECT_TRUE(surface->ReleaseBuffer(buffer));
+    }
+    delete surface;
+    BufferManager::GetInstance()->FlushDeferredFree();
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface buffer frame metadata
+ * SubFunction: NA
+ * FunctionPoints: standard frame metadata is transferred from producer to consumer.
+ * EnvConditions: NA
+ * CaseDescription: Consumer reads the timestamp, crop and transform set by producer, invalid metadata is rejected.
+ */
+HWTEST_F(SurfaceTest, surface_016, TestSize.Level1)
+{
+    Surface* surface = Surface::CreateSurface();
+    ASSERT_TRUE(surface);
+    surface->SetWidthAndHeight(100, 10);
+    SurfaceBuffer* buffer = surface->RequestBuffer(1);
+    ASSERT_TRUE(buffer);
+    EXPECT_EQ(0, buffer->GetFrameMetadata().fields);
+    FrameMetadata metadata = {0};
+    metadata.fields = FRAME_METADATA_TRANSFORM;
+    metadata.transform = FRAME_TRANSFORM_MAX;
+    EXPECT_NE(0, buffer->SetFrameMetadata(metadata));
+    metadata.fields = FRAME_METADATA_PRESENT_TIMESTAMP | FRAME_METADATA_CROP | FRAME_METADATA_TRANSFORM;
+    metadata.presentTimestamp = 1000000; // 1ms
+    metadata.cropWidth = 96;
+    metadata.cropHeight = 8;
+    metadata.transform = FRAME_TRANSFORM_ROTATE_90;
+    EXPECT_EQ(0, buffer->SetFrameMetadata(metadata));
+    EXPECT_EQ(0, surface->FlushBuffer(buffer));
+
+    buffer = surface->AcquireBuffer();
+    ASSERT_TRUE(buffer);
+    const FrameMetadata& acquired = buffer->GetFrameMetadata();
+    EXPECT_EQ(metadata.fields, acquired.fields);
+    EXPECT_EQ(1000000, acquired.presentTimestamp);
+    EXPECT_EQ(96, acquired.cropWidth);
+    EXPECT_EQ(FRAME_TRANSFORM_ROTATE_90, acquired.transform);
+    EXPECT_TRUE(surface->ReleaseBuffer(buffer));
+
+    buffer = surface->RequestBuffer(1);
+    ASSERT_TRUE(buffer);
+    EXPECT_EQ(0, buffer->GetFrameMetadata().fields); // cleared on release
+    surface->CancelBuffer(buffer);
+    delete surface;
+    BufferManager::GetInstance()->FlushDeferredFree();
+}
+
+/*
+ * Feature: Buffer manager
+ * Function: Buffer manager recycling cache
+ * SubFunction: NA
+ * FunctionPoints: freed buffers are reused by allocations of the same geometry.
+ * EnvConditions: NA
+ * CaseDescription: Buffer manager reuses freed buffers in the byte budget and evicts the least recently freed.
+ */
+HWTEST_F(SurfaceTest, buffer_manager_cache_001, TestSize.Level1)
+{
+    BufferManager* manager = BufferManager::GetInstance();
+    ASSERT_TRUE(manager);
+    ASSERT_TRUE(manager->Init());
+    manager->FlushDeferredFree();
+    manager->TrimCache();
+    manager->SetCacheBudget(2048); // 2048B, hold two 1024B buffers at most.
+    BufferCacheStats base = manager->GetCacheStats();
+
+    SurfaceBufferImpl* buffer = manager->AllocBuffer(1024, BUFFER_CONSUMER_USAGE_SORTWARE);
+    ASSERT_TRUE(buffer);
+    void* virAddr = buffer->GetVirAddr();
+    manager->FreeBuffer(&buffer);
+    EXPECT_EQ(nullptr, buffer);
+    EXPECT_EQ(base.cachedBytes + 1024, manager->GetCacheStats().cachedBytes);
+
+    buffer = manager->AllocBuffer(1024, BUFFER_CONSUMER_USAGE_SORTWARE);
+    ASSERT_TRUE(buffer);
+    EXPECT_EQ(virAddr, buffer->GetVirAddr());
+    BufferCacheStats stats = manager->GetCacheStats();
+    EXPECT_EQ(base.hits + 1, stats.hits);
+    EXPECT_EQ(base.misses + 1, stats.misses);
+
+    SurfaceBufferImpl* other = manager->AllocBuffer(512, BUFFER_CONSUMER_USAGE_SORTWARE);
+    ASSERT_TRUE(other);
+    SurfaceBufferImpl* large = manager->AllocBuffer(1536, BUFFER_CONSUMER_USAGE_SORTWARE);
+    ASSERT_TRUE(large);
+    manager->FreeBuffer(&buffer);
+    manager->FreeBuffer(&other);
+    manager->FreeBuffer(&large); // evicts 1024B buffer, the least recently freed.
+    stats = manager->GetCacheStats();
+    EXPECT_EQ(base.evictions + 1, stats.evictions);
+    EXPECT_EQ(2048, stats.cachedBytes);
+
+    manager->TrimCache();
+    EXPECT_EQ(0, manager->GetCacheStats().cachedBytes);
+    manager->SetCacheBudget(4 * 1024 * 1024); // restore default 4MB.
+}
+
+/*
+ * Feature: Buffer manager
+ * Function: Buffer manager concurrent alloc and free
+ * SubFunction: NA
+ * FunctionPoints: buffer registry is safe for concurrent use.
+ * EnvConditions: NA
+ * CaseDescription: Threads alloc and free hundreds of live buffers concurrently, every buffer is registered and freed.
+ */
+HWTEST_F(SurfaceTest, buffer_manager_registry_001, TestSize.Level1)
+{
+    const uint32_t threadNum = 8;
+    BufferManager* manager = BufferManager::GetInstance();
+    ASSERT_TRUE(manager);
+    ASSERT_TRUE(manager->Init());
+
+    pthread_t threads[threadNum];
+    for (uint32_t i = 0; i < threadNum; i++) {
+        ASSERT_EQ(0, pthread_create(&threads[i], nullptr, AllocFreeBuffers, nullptr));
+    }
+    for (uint32_t i = 0; i < threadNum; i++) {
+        void* failed = nullptr;
+        EXPECT_EQ(0, pthread_join(threads[i], &failed));
+        EXPECT_EQ(nullptr, failed);
+    }
+    manager->FlushDeferredFree();
+    manager->TrimCache();
+    EXPECT_EQ(0, manager->GetCacheStats().cachedBytes);
+}
+
+/*
+ * Feature: Buffer manager
+ * Function: Buffer manager map buffer
+ * SubFunction: NA
+ * FunctionPoints: map, unmap and flush reuse the registered buffer handle.
+ * EnvConditions: NA
+ * CaseDescription: Map a copy of an allocated buffer returns the existing mapping, unmap keeps it valid.
+ */
+HWTEST_F(SurfaceTest, buffer_manager_map_001, TestSize.Level1)
+{
+    BufferManager* manager = BufferManager::GetInstance();
+    ASSERT_TRUE(manager);
+    ASSERT_TRUE(manager->Init());
+    SurfaceBufferImpl* buffer = manager->AllocBuffer(1024, BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE);
+    ASSERT_TRUE(buffer);
+
+    SurfaceBufferImpl proxy;
+    proxy.SetKey(buffer->GetKey());
+    proxy.SetPhyAddr(buffer->GetPhyAddr());
+    proxy.SetMaxSize(buffer->GetMaxSize());
+    proxy.SetUsage(BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE);
+    for (int32_t i = 0; i < 2; i++) { // map twice
+        EXPECT_TRUE(manager->MapBuffer(proxy));
+        EXPECT_EQ(buffer->GetVirAddr(), proxy.GetVirAddr());
+        EXPECT_EQ(0, manager->FlushCache(proxy));
+        manager->UnmapBuffer(proxy);
+    }
+    EXPECT_EQ(0, manager->FlushCache(*buffer)); // still registered after unmap.
+    manager->FreeBuffer(&buffer);
+    EXPECT_EQ(-1, manager->FlushCache(proxy));
+}
+
+/*
+ * Feature: Buffer manager
+ * Function: Buffer manager allocator backend
+ * SubFunction: NA
+ * FunctionPoints: allocate buffers from the backend selected by usage
+ * EnvConditions: NA
+ * CaseDescription: Buffers of the usage are allocated, mapped, flushed, freed and counted by the selected allocator.
+ */
+HWTEST_F(SurfaceTest, buffer_manager_allocator_001, TestSize.Level1)
+{
+    BufferManager* manager = BufferManager::GetInstance();
+    ASSERT_TRUE(manager);
+    ASSERT_TRUE(manager->Init());
+    EXPECT_TRUE(manager->SetAllocator(BUFFER_CONSUMER_USAGE_MAX, nullptr) != 0);
+    const BufferAllocatorType types[] = {
+        BUFFER_ALLOCATOR_MEMFD, BUFFER_ALLOCATOR_ANONYMOUS, BUFFER_ALLOCATOR_HUGE_PAGE
+    };
+    for (uint32_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        BufferAllocator* allocator = BufferAllocator::GetBuiltin(types[i]);
+        ASSERT_TRUE(allocator);
+        EXPECT_EQ(0, manager->SetAllocator(BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE, allocator));
+        manager->TrimCache();
+        uint64_t usage = manager->GetMemoryUsage();
+        SurfaceBufferImpl* buffer = manager->AllocBuffer(100, 10, IMAGE_PIXEL_FORMAT_RGB565,
+            BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE);
+        if (types[i] == BUFFER_ALLOCATOR_MEMFD && buffer == nullptr) {
+            continue; // memfd is not supported by the kernel.
+        }
+        ASSERT_TRUE(buffer);
+        uint64_t footprint = (types[i] == BUFFER_ALLOCATOR_HUGE_PAGE) ? 2097152 : 2080; // 2MB huge page, or size
+        EXPECT_EQ(usage + footprint, manager->GetMemoryUsage());
+        EXPECT_EQ(208, buffer->GetStride()); // 100 * 2 bytes aligned to 16 bytes
+        EXPECT_EQ(2080, buffer->GetMaxSize()); // 208 stride * 10 height
+        ASSERT_TRUE(buffer->GetVirAddr());
+        uint8_t* virAddr = static_cast<uint8_t*>(buffer->GetVirAddr());
+        virAddr[0] = 0xFF;
+        virAddr[buffer->GetMaxSize() - 1] = 0xFF; // last byte is writable
+        EXPECT_TRUE(manager->MapBuffer(*buffer));
+        EXPECT_EQ(0, manager->FlushCache(*buffer));
+        EXPECT_EQ(0, manager->FlushCache(*buffer, 0, 64)); // flush first 64 bytes
+        manager->FreeBuffer(&buffer);
+    }
+    EXPECT_EQ(0, manager->SetAllocator(BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE, nullptr));
+    manager->TrimCache();
+}
+
+/*
+ * Feature: Surface
+ * Function: Buffer manager memory budget
+ * SubFunction: NA
+ * FunctionPoints: memory budget is reserved before the buffer is allocated.
+ * EnvConditions: NA
+ * CaseDescription: Allocation over the memory budget fails without taking memory from the allocator.
+ */
+HWTEST_F(SurfaceTest, buffer_manager_budget_001, TestSize.Level1)
+{
+    BufferManager* manager = BufferManager::GetInstance();
+    ASSERT_TRUE(manager);
+    ASSERT_TRUE(manager->Init());
+    CountingAllocator allocator;
+    EXPECT_EQ(0, manager->SetAllocator(BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE, &allocator));
+    manager->TrimCache();
+    uint64_t usage = manager->GetMemoryUsage();
+    manager->SetMemoryBudget(usage + 2080); // 2080: 100 x 10 RGB565 in rows of 208 bytes
+    SurfaceBufferImpl* buffer = manager->AllocBuffer(100, 11, IMAGE_PIXEL_FORMAT_RGB565,
+        BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE);
+    EXPECT_EQ(nullptr, buffer); // one more row exceeds the budget
+    EXPECT_EQ(0, allocator.GetAllocCount());
+    EXPECT_EQ(usage, manager->GetMemoryUsage());
+
+    buffer = manager->AllocBuffer(100, 10, IMAGE_PIXEL_FORMAT_RGB565, BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE);
+    ASSERT_TRUE(buffer);
+    EXPECT_EQ(1, allocator.GetAllocCount());
+    EXPECT_EQ(usage + 2080, manager->GetMemoryUsage());
+    manager->FreeBuffer(&buffer);
+    manager->FlushDeferredFree();
+    manager->TrimCache();
+    manager->SetMemoryBudget(0);
+    EXPECT_EQ(0, manager->SetAllocator(BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE, nullptr));
+}
+
+/*
+ * Feature: Surface
+ * Function: Buffer queue config snapshot
+ * SubFunction: NA
+ * FunctionPoints: all attributes are read at once together with the config generation.
+ * EnvConditions: NA
+ * CaseDescription: Config generation is kept while attributes are unchanged and increased on change.
+ */
+HWTEST_F(SurfaceTest, surface_017, TestSize.Level1)
+{
+    BufferQueue* queue = new BufferQueue();
+    ASSERT_TRUE(queue);
+    ASSERT_TRUE(queue->Init());
+    queue->SetWidthAndHeight(100, 10);
+    BufferQueueConfig config = {0};
+    queue->GetConfig(config);
+    EXPECT_EQ(100, config.width);
+    EXPECT_EQ(10, config.height);
+    EXPECT_EQ(queue->GetFormat(), config.format);
+    EXPECT_EQ(queue->GetQueueSize(), config.queueSize);
+    EXPECT_EQ(queue->GetConfigGeneration(), config.generation);
+
+    uint32_t generation = config.generation;
+    queue->GetConfig(config);
+    EXPECT_EQ(generation, config.generation); // unchanged attributes keep the generation
+    queue->SetFormat(IMAGE_PIXEL_FORMAT_ARGB8888);
+    queue->GetConfig(config);
+    EXPECT_NE(generation, config.generation);
+    EXPECT_EQ(IMAGE_PIXEL_FORMAT_ARGB8888, config.format);
+    delete queue;
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface flush and request Buffer
+ * SubFunction: NA
+ * FunctionPoints: flush previous buffer and request next buffer at once.
+ * EnvConditions: NA
+ * CaseDescription: Flushed buffer is acquired by consumer, next buffer is returned only if one is free.
+ */
+HWTEST_F(SurfaceTest, surface_018, TestSize.Level1)
+{
+    Surface* surface = Surface::CreateSurface();
+    ASSERT_TRUE(surface);
+    surface->SetSize(1024); // Set alloc 1024B SHM
+    surface->SetQueueSize(2); // only 2 buffers could be allocated
+    SurfaceBuffer* next = nullptr;
+    EXPECT_NE(0, surface->FlushAndRequestBuffer(nullptr, next));
+    EXPECT_EQ(nullptr, next);
+
+    SurfaceBuffer* first = surface->RequestBuffer(1);
+    ASSERT_TRUE(first);
+    SurfaceBuffer* second = surface->RequestBuffer(1); // wait for the worker to allocate the second buffer
+    ASSERT_TRUE(second);
+    surface->CancelBuffer(second);
+    EXPECT_EQ(0, surface->FlushAndRequestBuffer(first, next));
+    EXPECT_EQ(second, next);
+    EXPECT_EQ(0, surface->FlushAndRequestBuffer(second, next));
+    EXPECT_EQ(nullptr, next); // both buffers are in dirty queue
+
+    SurfaceBuffer* acquired = surface->AcquireBuffer();
+    EXPECT_EQ(first, acquired);
+    EXPECT_TRUE(surface->ReleaseBuffer(acquired));
+    acquired = surface->AcquireBuffer();
+    EXPECT_EQ(second, acquired);
+    EXPECT_TRUE(surface->ReleaseBuffer(acquired));
+    delete surface;
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface one-way flush Buffer
+ * SubFunction: NA
+ * FunctionPoints: one-way flush request is handled and its error is reported with next reply.
+ * EnvConditions: NA
+ * CaseDescription: Consumer acquires the buffer flushed one-way, the error of invalid flush is in next reply.
+ */
+HWTEST_F(SurfaceTest, surface_019, TestSize.Level1)
+{
+    SurfaceImpl* surface = reinterpret_cast<SurfaceImpl*>(Surface::CreateSurface());
+    ASSERT_TRUE(surface);
+    EXPECT_NE(0, surface->SetAsyncMode(true)); // only for the surface in producer process
+    surface->SetSize(1024); // Set alloc 1024B SHM
+    SurfaceBufferImpl* buffer = reinterpret_cast<SurfaceBufferImpl*>(surface->RequestBuffer(1));
+    ASSERT_TRUE(buffer);
+    const int32_t ipcSize = 1024;
+    uint8_t data[ipcSize];
+    IpcIo io;
+    IpcIoInit(&io, data, ipcSize, 0);
+    WriteUint32(&io, buffer->GetSlot()); // buffer is referred by slot
+    WriteInt32(&io, buffer->GetKey());
+    buffer->WriteExtraDataToIpcIo(io);
+    MessageOption option;
+    MessageOptionInit(&option);
+    option.flags = TF_OP_ASYNC | TF_OP_STATUS_CODE; // one-way whatever other bits are set
+    for (int32_t i = 0; i < 2; i++) { // flushed twice, the second one fails.
+        IpcIo request;
+        IpcIoInit(&request, data, ipcSize - io.bufferLeft, 0);
+        surface->DoIpcMsg(FLUSH_BUFFER, &request, nullptr, option);
+    }
+    SurfaceBuffer* acquired = surface->AcquireBuffer();
+    ASSERT_TRUE(acquired);
+    EXPECT_EQ(buffer, acquired);
+    EXPECT_TRUE(surface->ReleaseBuffer(acquired));
+
+    IpcIoInit(&io, data, ipcSize, 0);
+    WriteUint8(&io, 0);
+    IpcIo request;
+    IpcIoInit(&request, data, ipcSize - io.bufferLeft, 0);
+    uint8_t replyData[ipcSize];
+    IpcIo reply;
+    IpcIoInit(&reply, replyData, ipcSize, 0);
+    option.flags = TF_OP_SYNC;
+    EXPECT_EQ(0, surface->DoIpcMsg(REQUEST_BUFFER, &request, &reply, option));
+    IpcIo replyIn;
+    IpcIoInit(&replyIn, replyData, ipcSize - reply.bufferLeft, 0);
+    int32_t ret = -1;
+    uint32_t generation = 0;
+    int32_t asyncError = SURFACE_ERROR_OK;
+    ReadInt32(&replyIn, &ret);
+    ReadUint32(&replyIn, &generation);
+    ReadUint32(&replyIn, &generation);
+    ReadInt32(&replyIn, &asyncError);
+    EXPECT_EQ(0, ret);
+    EXPECT_EQ(SURFACE_ERROR_BUFFER_NOT_EXISTED, asyncError);
+    buffer = reinterpret_cast<SurfaceBufferImpl*>(surface->RequestBuffer());
+    EXPECT_EQ(nullptr, buffer); // the buffer is requested by ipc message.
+    delete surface;
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface request Buffer by slot
+ * SubFunction: NA
+ * FunctionPoints: buffer mapped by remote producer is referred by slot instead of whole buffer handle.
+ * EnvConditions: NA
+ * CaseDescription: Whole buffer is sent for unknown slot, only slot and key for the slot known in the generation.
+ */
+HWTEST_F(SurfaceTest, surface_020, TestSize.Level1)
+{
+    SurfaceImpl* surface = reinterpret_cast<SurfaceImpl*>(Surface::CreateSurface());
+    ASSERT_TRUE(surface);
+    surface->SetSize(1024); // Set alloc 1024B SHM
+    const int32_t ipcSize = 1024;
+    uint32_t knownGeneration = 0;
+    uint32_t knownSlots = 0;
+    for (int32_t i = 0; i < 2; i++) { // the second request knows the slot of the first one.
+        uint8_t data[ipcSize];
+        IpcIo io;
+        IpcIoInit(&io, data, ipcSize, 0);
+        WriteUint8(&io, 1); // wait for the worker
+        WriteUint32(&io, knownGeneration);
+        WriteUint32(&io, knownSlots);
+        IpcIo request;
+        IpcIoInit(&request, data, ipcSize - io.bufferLeft, 0);
+        uint8_t replyData[ipcSize];
+        IpcIo reply;
+        IpcIoInit(&reply, replyData, ipcSize, 0);
+        MessageOption option;
+        MessageOptionInit(&option);
+        EXPECT_EQ(0, surface->DoIpcMsg(REQUEST_BUFFER, &request, &reply, option));
+        IpcIo replyIn;
+        IpcIoInit(&replyIn, replyData, ipcSize - reply.bufferLeft, 0);
+        int32_t ret = -1;
+        uint32_t configGeneration = 0;
+        int32_t asyncError = SURFACE_ERROR_OK;
+        uint32_t slot = BUFFER_SLOT_INVALID;
+        int32_t key = 0;
+        bool whole = false;
+        ReadInt32(&replyIn, &ret);
+        ReadUint32(&replyIn, &knownGeneration);
+        ReadUint32(&replyIn, &configGeneration);
+        ReadInt32(&replyIn, &asyncError);
+        ReadUint32(&replyIn, &slot);
+        ReadInt32(&replyIn, &key);
+        ReadBool(&replyIn, &whole);
+        EXPECT_EQ(0, ret);
+        ASSERT_TRUE(slot < BUFFER_SLOT_MAX);
+        EXPECT_EQ(i == 0, whole);
+        knownSlots |= (1u << slot);
+
+        IpcIoInit(&io, data, ipcSize, 0);
+        WriteUint32(&io, slot);
+        WriteInt32(&io, key);
+        IpcIoInit(&request, data, ipcSize - io.bufferLeft, 0);
+        IpcIoInit(&reply, replyData, ipcSize, 0);
+        EXPECT_EQ(0, surface->DoIpcMsg(CANCEL_BUFFER, &request, &reply, option));
+    }
+    SurfaceBuffer* buffer = surface->RequestBuffer(1);
+    ASSERT_TRUE(buffer); // canceled by slot
+    surface->CancelBuffer(buffer);
+    delete surface;
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface request Buffer without wait
+ * SubFunction: NA
+ * FunctionPoints: no-wait request and attach never take the slot of the background top-up allocation.
+ * EnvConditions: NA
+ * CaseDescription: No-wait request and attach fail during the allocation, waiting request gets the buffer.
+ */
+HWTEST_F(SurfaceTest, surface_021, TestSize.Level1)
+{
+    const uint32_t allocDelay = 50000; // 50ms, slow enough to request during the background allocation
+    BufferManager* manager = BufferManager::GetInstance();
+    ASSERT_TRUE(manager);
+    ASSERT_TRUE(manager->Init());
+    SlowAllocator allocator(allocDelay);
+    EXPECT_EQ(0, manager->SetAllocator(BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE, &allocator));
+    Surface* other = Surface::CreateSurface();
+    ASSERT_TRUE(other);
+    other->SetUsage(BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE);
+    other->SetSize(1024); // Set alloc 1024B SHM
+    SurfaceBuffer* detached = other->RequestBuffer(1);
+    ASSERT_TRUE(detached);
+    EXPECT_EQ(0, other->DetachBuffer(detached));
+    Surface* surface = Surface::CreateSurface();
+    ASSERT_TRUE(surface);
+    surface->SetQueueSize(2); // 2 buffers
+    surface->SetUsage(BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE);
+    surface->SetSize(1024); // Set alloc 1024B SHM
+    SurfaceBuffer* first = surface->RequestBuffer(1);
+    ASSERT_TRUE(first);
+    usleep(allocDelay / 10); // the worker is allocating the second buffer
+    EXPECT_EQ(nullptr, surface->RequestBuffer(0)); // returns at once rather than waiting
+    EXPECT_EQ(SURFACE_ERROR_NOT_READY, surface->AttachBuffer(detached, false)); // the last slot is in flight
+    SurfaceBuffer* second = surface->RequestBuffer(1);
+    ASSERT_TRUE(second); // waits for the allocation in flight
+    EXPECT_NE(first, second);
+    EXPECT_EQ(nullptr, surface->RequestBuffer()); // queue is full
+    surface->CancelBuffer(first);
+    surface->CancelBuffer(second);
+    delete surface;
+    EXPECT_EQ(0, other->FreeDetachedBuffer(detached));
+    delete other;
+    manager->FlushDeferredFree();
+    manager->TrimCache();
+    EXPECT_EQ(0, manager->SetAllocator(BUFFER_CONSUMER_USAGE_HARDWARE_PRODUCER_CACHE, nullptr));
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface attach Buffer by attributes
+ * SubFunction: NA
+ * FunctionPoints: attached buffer matches width, height and format of the queue before any allocation.
+ * EnvConditions: NA
+ * CaseDescription: Empty queue configured by width and height rejects a smaller buffer or another format.
+ */
+HWTEST_F(SurfaceTest, surface_022, TestSize.Level1)
+{
+    const uint32_t bufferNum = 4;
+    Surface* producers[bufferNum] = { nullptr };
+    SurfaceBuffer* buffers[bufferNum] = { nullptr };
+    for (uint32_t i = 0; i < bufferNum; i++) {
+        producers[i] = Surface::CreateSurface();
+        ASSERT_TRUE(producers[i]);
+        producers[i]->SetWidthAndHeight(100, 10); // 100 : width, 10 : height
+    }
+    producers[0]->SetWidthAndHeight(50, 10); // 50 : smaller width, 10 : height
+    producers[1]->SetFormat(IMAGE_PIXEL_FORMAT_ARGB8888); // larger buffer of another format
+    producers[2]->SetSize(4096); // Set alloc 4096B SHM, larger buffer allocated by size
+    for (uint32_t i = 0; i < bufferNum; i++) {
+        buffers[i] = producers[i]->RequestBuffer(1);
+        ASSERT_TRUE(buffers[i]);
+        EXPECT_EQ(0, producers[i]->DetachBuffer(buffers[i]));
+    }
+
+    Surface* surface = Surface::CreateSurface();
+    ASSERT_TRUE(surface);
+    surface->SetWidthAndHeight(100, 10); // 100 : width, 10 : height
+    EXPECT_EQ(0, surface->GetSize()); // nothing is allocated yet
+    for (uint32_t i = 0; i < bufferNum - 1; i++) {
+        EXPECT_EQ(SURFACE_ERROR_INVALID_PARAM, surface->AttachBuffer(buffers[i], false));
+        EXPECT_EQ(0, producers[i]->FreeDetachedBuffer(buffers[i]));
+    }
+    EXPECT_EQ(0, surface->AttachBuffer(buffers[bufferNum - 1], false)); // same attributes
+    EXPECT_EQ(buffers[bufferNum - 1], surface->RequestBuffer(0));
+    surface->CancelBuffer(buffers[bufferNum - 1]);
+
+    delete surface;
+    for (uint32_t i = 0; i < bufferNum; i++) {
+        delete producers[i];
+    }
+}
+
+/*
+ * Feature: Surface
+ * Function: Surface set acquire any Buffer
+ * SubFunction: NA
+ * FunctionPoints: acquire buffer from many surfaces with a single wait
+ * EnvConditions: NA
+ * CaseDescription: Surface set returns ready buffers from all surfaces in round-robin order.
+ */
+HWTEST_F(SurfaceTest, surface_set_any_001, TestSize.Level1)
+{
+    SurfaceSet* surfaceSet = SurfaceSet::CreateSurfaceSet();
+    ASSERT_TRUE(surfaceSet);
+    Surface* first = Surface::CreateSurface();
+    Surface* second = Surface::CreateSurface();
+    if (first == nullptr || second == nullptr) {
+        delete first;
+        delete second;
+        delete surfaceSet;
+        return;
+    }
+    first->SetSize(1024); // Set alloc 1024B SHM
+    first->SetQueueSize(2); // first surface could alloc 2 buffers
+    second->SetSize(1024); // Set alloc 1024B SHM
+    EXPECT_EQ(0, surfaceSet->AddSurface(first));
+    EXPECT_EQ(0, surfaceSet->AddSurface(second));
+    EXPECT_TRUE(surfaceSet->AddSurface(first) != 0); // Added, could not add again.
+
+    Surface* surface = nullptr;
+    EXPECT_FALSE(surfaceSet->AcquireAny(surface, 0)); // no buffer flushed, return null pointer.
+    EXPECT_FALSE(surfaceSet->AcquireAny(surface, 10)); // wait 10ms, return null pointer.
+
+    EXPECT_EQ(0, first->FlushBuffer(first->RequestBuffer(1)));
+    EXPECT_EQ(0, first->FlushBuffer(first->RequestBuffer(1)));
+    EXPECT_EQ(0, second->FlushBuffer(second->RequestBuffer(1)));
+
+    SurfaceBuffer* buffer = surfaceSet->AcquireAny(surface, -1);
+    ASSERT_TRUE(buffer);
+    Surface* firstReady = surface;
+    EXPECT_TRUE(surface->ReleaseBuffer(buffer));
+    buffer = surfaceSet->AcquireAny(surface, -1);
+    ASSERT_TRUE(buffer);
+    EXPECT_TRUE(surface != firstReady); // the other ready surface is served before first one again.
+    EXPECT_TRUE(surface->ReleaseBuffer(buffer));
+    buffer = surfaceSet->AcquireAny(surface, 0);
+    ASSERT_TRUE(buffer);
+    EXPECT_EQ(first, surface);
+    EXPECT_TRUE(surface->ReleaseBuffer(buffer));
+    EXPECT_FALSE(surfaceSet->AcquireAny(surface, 0));
+
+    EXPECT_EQ(0, surfaceSet->RemoveSurface(first));
+    EXPECT_TRUE(surfaceSet->RemoveSurface(first) != 0);
+    EXPECT_EQ(0, first->FlushBuffer(first->RequestBuffer(1)));
+    EXPECT_FALSE(surfaceSet->AcquireAny(surface, 0)); // removed surface is not watched.
+
+    delete surfaceSet;
+    delete first;
+    delete second;
+}
 } // namespace OHOS